@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstring>
+
+#include "capture.h"
+
+void collectCapturedFrame(FrameCapture& capture, const size_t& slot);
+void writeCapturedFrames(FrameCapture& capture);
+void writeY4mFrame(std::ofstream& file, const std::vector<uint8_t>& frame,
+                   const GLsizei& width, const GLsizei& height,
+                   std::vector<uint8_t>& planes);
+void writeRawFrame(std::ofstream& file, const std::vector<uint8_t>& frame,
+                   const GLsizei& width, const GLsizei& height,
+                   std::vector<uint8_t>& rows);
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startFrameCapture(FrameCapture& capture,
+                  const std::filesystem::path& path,
+                  const GLsizei& width,
+                  const GLsizei& height,
+                  const size_t& memoryBudget) {
+    capture.file.open(path, std::ios::binary | std::ios::trunc);
+    if (!capture.file.is_open()) return ErrorResult{
+        "Fail to open file: " + path.string()
+    };
+
+    capture.width = width;
+    capture.height = height;
+    capture.maxPending = std::max<size_t>(
+        memoryBudget / ((size_t)width * height * 4), 1
+    );
+    capture.frame = 0;
+    capture.stalledFrames = 0;
+    capture.droppedFrames = 0;
+    capture.y4m = path.extension() == ".y4m";
+    if (capture.y4m) {
+        capture.file << "YUV4MPEG2 W" << width << " H" << height
+                     << " F60:1 Ip A1:1 C444\n";
+    }
+
+    // RGBA matches the framebuffer layout, which keeps the readback on the
+    // driver's fast path.
+    glGenBuffers((GLsizei)capture.buffers.size(), capture.buffers.data());
+    for (const auto& buffer : capture.buffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4,
+                     nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    capture.stopping = false;
+    capture.error.clear();
+    capture.writer = std::thread{ writeCapturedFrames, std::ref(capture) };
+    return SuccessResult<const std::filesystem::path>{
+        std::filesystem::absolute(path)
+    };
+}
+
+void captureFrame(FrameCapture& capture) {
+    if (!capture.writer.joinable()) return;
+
+    const auto slot{ capture.frame % FrameCapture::latency };
+    if (capture.frame >= FrameCapture::latency)
+        collectCapturedFrame(capture, slot);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[slot]);
+    glReadPixels(0, 0, capture.width, capture.height, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++capture.frame;
+}
+
+const std::variant<SuccessResult<const uint64_t>, ErrorResult>
+stopFrameCapture(FrameCapture& capture) {
+    if (!capture.writer.joinable()) return SuccessResult<const uint64_t>{ 0 };
+
+    const auto inFlight{ std::min<uint64_t>(capture.frame,
+                                            FrameCapture::latency) };
+    for (auto frame{ capture.frame - inFlight }; frame < capture.frame; ++frame)
+        collectCapturedFrame(capture, frame % FrameCapture::latency);
+    glDeleteBuffers((GLsizei)capture.buffers.size(), capture.buffers.data());
+
+    {
+        const std::lock_guard lock{ capture.mutex };
+        capture.stopping = true;
+    }
+    capture.framesPending.notify_one();
+    capture.writer.join();
+    capture.file.close();
+    capture.spareFrames.clear();
+
+    if (!capture.error.empty()) return ErrorResult{ capture.error };
+    return SuccessResult<const uint64_t>{
+        capture.frame - capture.droppedFrames
+    };
+}
+
+// Copies a finished readback out of its buffer and hands it to the writer.
+void collectCapturedFrame(FrameCapture& capture, const size_t& slot) {
+    glClientWaitSync(capture.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+                     GL_TIMEOUT_IGNORED);
+    glDeleteSync(capture.fences[slot]);
+
+    std::vector<uint8_t> frame{};
+    {
+        std::unique_lock lock{ capture.mutex };
+        if (capture.pending.size() >= capture.maxPending) {
+            ++capture.stalledFrames;
+            capture.frameWritten.wait(lock, [&]() {
+                return capture.pending.size() < capture.maxPending;
+            });
+        }
+        if (!capture.spareFrames.empty()) {
+            frame = std::move(capture.spareFrames.back());
+            capture.spareFrames.pop_back();
+        }
+    }
+    frame.resize((size_t)capture.width * capture.height * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[slot]);
+    const auto pixels{ glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        (GLsizeiptr)frame.size(),
+                                        GL_MAP_READ_BIT) };
+    if (pixels != nullptr) {
+        std::memcpy(frame.data(), pixels, frame.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        const std::lock_guard lock{ capture.mutex };
+        if (pixels == nullptr) {
+            ++capture.droppedFrames;
+            capture.spareFrames.push_back(std::move(frame));
+            return;
+        }
+        capture.pending.push_back(std::move(frame));
+    }
+    capture.framesPending.notify_one();
+}
+
+void writeCapturedFrames(FrameCapture& capture) {
+    std::vector<uint8_t> scratch{};
+    while (true) {
+        std::vector<uint8_t> frame{};
+        {
+            std::unique_lock lock{ capture.mutex };
+            capture.framesPending.wait(lock, [&]() {
+                return !capture.pending.empty() || capture.stopping;
+            });
+            if (capture.pending.empty()) return;
+            frame = std::move(capture.pending.front());
+            capture.pending.pop_front();
+        }
+        capture.frameWritten.notify_one();
+
+        // Frames keep being drained after an error so memory stays bounded.
+        if (capture.file.good()) {
+            if (capture.y4m) {
+                writeY4mFrame(capture.file, frame, capture.width,
+                              capture.height, scratch);
+            } else {
+                writeRawFrame(capture.file, frame, capture.width,
+                              capture.height, scratch);
+            }
+        }
+
+        const std::lock_guard lock{ capture.mutex };
+        if (!capture.file.good() && capture.error.empty())
+            capture.error = "Fail to write captured frames";
+        capture.spareFrames.push_back(std::move(frame));
+    }
+}
+
+// BT.601 limited range. OpenGL returns the bottom row first.
+void writeY4mFrame(std::ofstream& file, const std::vector<uint8_t>& frame,
+                   const GLsizei& width, const GLsizei& height,
+                   std::vector<uint8_t>& planes) {
+    const auto planeSize{ (size_t)width * height };
+    planes.resize(3 * planeSize);
+    for (GLsizei row{ 0 }; row < height; ++row) {
+        const auto source{ &frame[(size_t)(height - 1 - row) * width * 4] };
+        const auto target{ (size_t)row * width };
+        for (GLsizei column{ 0 }; column < width; ++column) {
+            const int r{ source[4 * column] };
+            const int g{ source[4 * column + 1] };
+            const int b{ source[4 * column + 2] };
+            planes[target + column] =
+                (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            planes[planeSize + target + column] =
+                (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            planes[2 * planeSize + target + column] =
+                (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    file << "FRAME\n";
+    file.write((const char*)planes.data(), planes.size());
+}
+
+void writeRawFrame(std::ofstream& file, const std::vector<uint8_t>& frame,
+                   const GLsizei& width, const GLsizei& height,
+                   std::vector<uint8_t>& rows) {
+    rows.resize((size_t)width * height * 3);
+    for (GLsizei row{ 0 }; row < height; ++row) {
+        const auto source{ &frame[(size_t)(height - 1 - row) * width * 4] };
+        const auto target{ &rows[(size_t)row * width * 3] };
+        for (GLsizei column{ 0 }; column < width; ++column) {
+            target[3 * column] = source[4 * column];
+            target[3 * column + 1] = source[4 * column + 1];
+            target[3 * column + 2] = source[4 * column + 2];
+        }
+    }
+    file.write((const char*)rows.data(), rows.size());
+}
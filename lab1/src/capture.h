@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "result.h"
+
+// Records the framebuffer to a video file without stalling the pipeline.
+// Every frame is read into one of `latency` pixel-pack buffers and mapped
+// `latency` frames later, when the copy has long finished. A writer thread
+// converts and writes the frames. The frames waiting for it are bounded by a
+// memory budget; only when that is full does the render loop wait.
+struct FrameCapture {
+    static constexpr size_t latency{ 3 };
+
+    GLsizei width;
+    GLsizei height;
+    size_t maxPending;
+    std::array<GLuint, latency> buffers;
+    std::array<GLsync, latency> fences;
+    uint64_t frame;
+    // Frames that waited for the writer, and frames whose readback could not
+    // be mapped and were left out of the file.
+    uint64_t stalledFrames;
+    uint64_t droppedFrames;
+
+    // Y4M (4:4:4 YUV) when the file ends with .y4m, packed RGB24 otherwise.
+    bool y4m;
+    std::ofstream file;
+    std::thread writer;
+
+    // Guarded by `mutex`.
+    std::mutex mutex;
+    std::condition_variable framesPending;
+    std::condition_variable frameWritten;
+    std::deque<std::vector<uint8_t>> pending;
+    std::vector<std::vector<uint8_t>> spareFrames;
+    bool stopping;
+    std::string error;
+};
+
+// `memoryBudget` bytes of frames may wait for the writer, at least one frame.
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startFrameCapture(FrameCapture& capture,
+                  const std::filesystem::path& path,
+                  const GLsizei& width,
+                  const GLsizei& height,
+                  const size_t& memoryBudget);
+
+// Queues the bound read framebuffer. Does nothing unless capture has started.
+void captureFrame(FrameCapture& capture);
+
+// Writes the frames still in flight and returns how many were written.
+const std::variant<SuccessResult<const uint64_t>, ErrorResult>
+stopFrameCapture(FrameCapture& capture);
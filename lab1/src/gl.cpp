@@ -1,15 +1,79 @@
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include "glm/glm.hpp"
 
 #include "gl.h"
 
+#if __has_include(<EGL/egl.h>)
+#define LAB1_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// GL_ARB_get_program_binary is core only since 4.1, so the 3.3 glad loader
+// leaves it out; the entry points are resolved at runtime instead.
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGETPROGRAMBINARYPROC)(
+    GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat,
+    void* binary
+);
+typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(
+    GLuint program, GLenum binaryFormat, const void* binary, GLsizei length
+);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(
+    GLuint program, GLenum pname, GLint value
+);
+
+// Likewise GL_ARB_buffer_storage, core since 4.4.
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(
+    GLenum target, GLsizeiptr size, const void* data, GLbitfield flags
+);
+
+struct ProgramBinaryFunctions {
+    PFNGETPROGRAMBINARYPROC getProgramBinary;
+    PFNPROGRAMBINARYPROC programBinary;
+    PFNPROGRAMPARAMETERIPROC programParameteri;
+};
+
+// Resolves GL entry points glad does not load, through the API that created
+// the current context.
+GLADloadproc glProcLoader{ nullptr };
+
+const std::filesystem::path shaderProgramCachePath{ "cache" };
+std::unordered_map<uint64_t, GLuint> shaderProgramCache{};
+
 const std::variant<SuccessResult<const std::string>, ErrorResult> readFile(
     const std::string& filename
 );
+const std::optional<ProgramBinaryFunctions>& loadProgramBinaryFunctions();
+bool loadProgramBinary(const ProgramBinaryFunctions& functions,
+                       const GLuint& shaderProgram,
+                       const std::filesystem::path& path);
+void saveProgramBinary(const ProgramBinaryFunctions& functions,
+                       const GLuint& shaderProgram,
+                       const std::filesystem::path& path);
+void sortRenderQueue(RenderQueue& renderQueue);
+bool isDrawStateEqual(const DrawPacket& a, const DrawPacket& b);
+bool isGlSupported(const GLint& major, const GLint& minor,
+                   const std::string& extension);
+void* loadGlProc(const char* name);
+uint64_t hashFnv1a(const std::string& data);
 
 const std::variant<SuccessResult<GLFWwindow* const>, ErrorResult> initGl() {
     if (!glfwInit()) return ErrorResult{ "Fail to init glfw." };
@@ -28,19 +92,110 @@ const std::variant<SuccessResult<GLFWwindow* const>, ErrorResult> initGl() {
     glfwMakeContextCurrent(window);
 
     gladLoadGL();
+    glProcLoader = (GLADloadproc)glfwGetProcAddress;
     return SuccessResult<GLFWwindow* const>{ window };
 }
 
+#ifdef LAB1_HAS_EGL
+const std::variant<SuccessResult<const HeadlessGl>, ErrorResult>
+initHeadlessGl(const GLsizei& width, const GLsizei& height) {
+    const auto getPlatformDisplay{ (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT") };
+    auto display{
+        getPlatformDisplay != nullptr
+            ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, nullptr)
+            : EGL_NO_DISPLAY
+    };
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        return ErrorResult{ "Fail to init EGL." };
+
+    // Rendering goes to a framebuffer object, so any config will do, and
+    // Mesa's surfaceless platform may not expose one at all.
+    const std::string extensions{ eglQueryString(display, EGL_EXTENSIONS) };
+    EGLConfig config{ EGL_NO_CONFIG_KHR };
+    if (extensions.find("EGL_KHR_no_config_context") == std::string::npos) {
+        const std::array<EGLint, 3> configAttributes{
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLint configCount{};
+        if (!eglChooseConfig(display, configAttributes.data(), &config, 1,
+                             &configCount) || configCount < 1) {
+            eglTerminate(display);
+            return ErrorResult{ "No EGL config supports desktop OpenGL." };
+        }
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(display);
+        return ErrorResult{ "EGL does not support desktop OpenGL." };
+    }
+
+    const std::array<EGLint, 7> contextAttributes{
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    const auto context{ eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                         contextAttributes.data()) };
+    if (context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        eglTerminate(display);
+        return ErrorResult{ "Cannot create a surfaceless EGL context." };
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        eglTerminate(display);
+        return ErrorResult{ "Fail to load OpenGL functions." };
+    }
+    glProcLoader = (GLADloadproc)eglGetProcAddress;
+
+    HeadlessGl headlessGl{ .display{ display }, .context{ context } };
+    glGenFramebuffers(1, &headlessGl.framebuffer);
+    glGenRenderbuffers(1, &headlessGl.colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessGl.colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, headlessGl.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, headlessGl.colorRenderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cleanupHeadlessGl(headlessGl);
+        return ErrorResult{ "Incomplete offscreen framebuffer." };
+    }
+
+    return SuccessResult<const HeadlessGl>{ headlessGl };
+}
+
+void cleanupHeadlessGl(const HeadlessGl& headlessGl) {
+    glDeleteFramebuffers(1, &headlessGl.framebuffer);
+    glDeleteRenderbuffers(1, &headlessGl.colorRenderbuffer);
+    eglMakeCurrent(headlessGl.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    eglDestroyContext(headlessGl.display, headlessGl.context);
+    eglTerminate(headlessGl.display);
+}
+#else
+const std::variant<SuccessResult<const HeadlessGl>, ErrorResult>
+initHeadlessGl(const GLsizei& width, const GLsizei& height) {
+    return ErrorResult{ "Built without EGL, headless mode is unavailable." };
+}
+
+void cleanupHeadlessGl(const HeadlessGl& headlessGl) {}
+#endif
+
 void cleanupGl(
     GLFWwindow* const window,
     const std::span<const RenderObject>& renderObjects
 ) {
     for (const auto& renderObject : renderObjects) {
-        glDeleteProgram(renderObject.shaderProgram);
         glDeleteVertexArrays(1, &renderObject.VAO);
         glDeleteBuffers(1, &renderObject.VBO);
     }
+    cleanupShaderPrograms();
 
+    if (window == nullptr) return;
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -60,29 +215,437 @@ void buildTriangleVertices(const RenderObject& renderObject,
     glBindVertexArray(0);
 }
 
-const std::variant<SuccessResult<const GLuint>, ErrorResult> attachShader(
-    const GLuint& shaderProgram,
-    const std::string& shaderFilename,
-    const GLenum& shaderType
-) {
-    const auto readFileResult{ readFile(shaderFilename) };
-    if (std::holds_alternative<ErrorResult>(readFileResult))
-        return std::get<ErrorResult>(readFileResult);
+void buildTriangleInstances(const RenderObject& renderObject,
+                            StreamingBuffer& streamingBuffer,
+                            const std::span<const TriangleInstance>& instances) {
+    initStreamingBuffer(streamingBuffer, instances.size_bytes());
+    for (size_t region{ 0 }; region < StreamingBuffer::regionCount; ++region) {
+        std::memcpy(beginStreamingBufferWrite(streamingBuffer),
+                    instances.data(), instances.size_bytes());
+        endStreamingBufferWrite(streamingBuffer);
+    }
+
+    glBindVertexArray(renderObject.VAO);
+    for (GLuint attribute{ 1 }; attribute <= 5; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+    bindTriangleInstances(renderObject, streamingBuffer);
+}
+
+void bindTriangleInstances(const RenderObject& renderObject,
+                           const StreamingBuffer& streamingBuffer) {
+    glBindVertexArray(renderObject.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer.buffer);
+
+    const auto stride{ sizeof(TriangleInstance) };
+    const auto offset{ streamingBufferOffset(streamingBuffer) };
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(offset + offsetof(TriangleInstance, scale)));
+    glVertexAttribPointer(
+        2, 1, GL_FLOAT, GL_FALSE, stride,
+        (void*)(offset + offsetof(TriangleInstance, rotateDeg))
+    );
+    glVertexAttribPointer(
+        3, 1, GL_FLOAT, GL_FALSE, stride,
+        (void*)(offset + offsetof(TriangleInstance, pointSize))
+    );
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, stride,
+                           (void*)(offset + offsetof(TriangleInstance, flags)));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(offset + offsetof(TriangleInstance, color)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void initStreamingBuffer(StreamingBuffer& streamingBuffer,
+                         const GLsizeiptr& regionSize) {
+    streamingBuffer = StreamingBuffer{ .regionSize{ regionSize } };
+    const auto size{ regionSize * (GLsizeiptr)StreamingBuffer::regionCount };
+
+    glGenBuffers(1, &streamingBuffer.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer.buffer);
 
-    const auto shaderSrc{
-        std::get<SuccessResult<const std::string>>(readFileResult).value.c_str()
+    const auto bufferStorage{
+        isGlSupported(4, 4, "GL_ARB_buffer_storage")
+            ? (PFNBUFFERSTORAGEPROC)loadGlProc("glBufferStorage")
+            : nullptr
     };
+    if (bufferStorage != nullptr) {
+        const GLbitfield flags{
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT
+        };
+        bufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        streamingBuffer.persistentMapping = (GLbyte*)glMapBufferRange(
+            GL_ARRAY_BUFFER, 0, size, flags
+        );
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    const auto shader{ glCreateShader(shaderType) };
-    glShaderSource(shader, 1, &shaderSrc, nullptr);
-    glCompileShader(shader);
+void cleanupStreamingBuffer(StreamingBuffer& streamingBuffer) {
+    for (auto& fence : streamingBuffer.fences) {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    // Deleting a buffer implicitly unmaps it.
+    glDeleteBuffers(1, &streamingBuffer.buffer);
+    streamingBuffer.persistentMapping = nullptr;
+}
+
+GLbyte* beginStreamingBufferWrite(StreamingBuffer& streamingBuffer) {
+    streamingBuffer.region =
+        (streamingBuffer.region + 1) % StreamingBuffer::regionCount;
+
+    // The fence was placed regionCount - 1 frames ago, so this rarely waits.
+    auto& fence{ streamingBuffer.fences[streamingBuffer.region] };
+    if (fence != nullptr) {
+        GLenum waitResult{ GL_TIMEOUT_EXPIRED };
+        while (waitResult == GL_TIMEOUT_EXPIRED) {
+            waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                          1000000);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    const auto offset{ streamingBufferOffset(streamingBuffer) };
+    if (streamingBuffer.persistentMapping != nullptr)
+        return streamingBuffer.persistentMapping + offset;
+
+    // The fence already guarantees the GPU is done with the region, so the
+    // driver does not have to synchronize the mapping.
+    glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer.buffer);
+    return (GLbyte*)glMapBufferRange(
+        GL_ARRAY_BUFFER, offset, streamingBuffer.regionSize,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    );
+}
+
+void endStreamingBufferWrite(StreamingBuffer& streamingBuffer) {
+    if (streamingBuffer.persistentMapping != nullptr) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer.buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void fenceStreamingBuffer(StreamingBuffer& streamingBuffer) {
+    auto& fence{ streamingBuffer.fences[streamingBuffer.region] };
+    if (fence != nullptr) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr streamingBufferOffset(const StreamingBuffer& streamingBuffer) {
+    return streamingBuffer.regionSize * (GLintptr)streamingBuffer.region;
+}
 
-    glAttachShader(shaderProgram, shader);
+void markInstanceDirty(DirtyInstances& dirtyInstances, const size_t& index) {
+    if (dirtyInstances.pendingRegions.size() <= index)
+        dirtyInstances.pendingRegions.resize(index + 1, 0);
+    if (dirtyInstances.pendingRegions[index] == 0)
+        dirtyInstances.indices.push_back(index);
+    dirtyInstances.pendingRegions[index] = StreamingBuffer::regionCount;
+}
+
+void submitDrawPacket(RenderQueue& renderQueue, const DrawPacket& packet) {
+    renderQueue.packets.push_back(packet);
+}
+
+void flushRenderQueue(RenderQueue& renderQueue) {
+    sortRenderQueue(renderQueue);
+
+    auto& stats{ renderQueue.stats };
+    stats = RenderQueueStats{ .packets{ renderQueue.packets.size() } };
+
+    const DrawPacket* bound{ nullptr };
+    const auto& order{ renderQueue.order };
+    for (size_t idx{ 0 }; idx < order.size();) {
+        const auto& packet{ renderQueue.packets[order[idx]] };
+
+        if (bound == nullptr || bound->program != packet.program) {
+            glUseProgram(packet.program);
+            ++stats.stateChanges;
+        }
+        if (bound == nullptr || bound->VAO != packet.VAO) {
+            glBindVertexArray(packet.VAO);
+            ++stats.stateChanges;
+        }
+        // Uniforms belong to the program, so a program switch resets them.
+        if (packet.passLocation >= 0 &&
+            (bound == nullptr || bound->program != packet.program ||
+             bound->passLocation != packet.passLocation ||
+             bound->passValue != packet.passValue)) {
+            glUniform1ui(packet.passLocation, packet.passValue);
+            ++stats.stateChanges;
+        }
+        bound = &packet;
+
+        if (packet.instanceCount != 1) {
+            glDrawArraysInstanced(packet.primitive, packet.first, packet.count,
+                                  packet.instanceCount);
+            ++stats.drawCalls;
+            ++idx;
+            continue;
+        }
+
+        renderQueue.multiDrawFirsts.clear();
+        renderQueue.multiDrawCounts.clear();
+        for (; idx < order.size(); ++idx) {
+            const auto& next{ renderQueue.packets[order[idx]] };
+            if (next.instanceCount != 1 || !isDrawStateEqual(packet, next))
+                break;
+            renderQueue.multiDrawFirsts.push_back(next.first);
+            renderQueue.multiDrawCounts.push_back(next.count);
+        }
+        glMultiDrawArrays(packet.primitive,
+                          renderQueue.multiDrawFirsts.data(),
+                          renderQueue.multiDrawCounts.data(),
+                          (GLsizei)renderQueue.multiDrawFirsts.size());
+        ++stats.drawCalls;
+    }
+
+    size_t naiveStateChanges{ 0 };
+    for (const auto& packet : renderQueue.packets)
+        naiveStateChanges += packet.passLocation >= 0 ? 3 : 2;
+    stats.stateChangesAvoided = naiveStateChanges - stats.stateChanges;
+
+    renderQueue.packets.clear();
+}
+
+// Stable LSD radix sort of the packet order by a key built from dense per-
+// frame ids of each state field. Ids only steer the ordering; drawing still
+// compares the real state, so an id overflow cannot merge unrelated draws.
+void sortRenderQueue(RenderQueue& renderQueue) {
+    const auto& packets{ renderQueue.packets };
+    std::vector<GLuint> programs{}, VAOs{}, passValues{};
+    const auto denseId{ [](auto& values, const auto& value) -> uint64_t {
+        const auto found{ std::find(values.begin(), values.end(), value) };
+        if (found != values.end()) return found - values.begin();
+        values.push_back(value);
+        return values.size() - 1;
+    } };
+
+    auto& keys{ renderQueue.keys };
+    keys.resize(packets.size());
+    for (size_t idx{ 0 }; idx < packets.size(); ++idx) {
+        const auto& packet{ packets[idx] };
+        keys[idx] = (uint64_t)packet.layer << 56 |
+            (denseId(programs, packet.program) & 0xffff) << 40 |
+            (denseId(VAOs, packet.VAO) & 0xffff) << 24 |
+            (uint64_t)(packet.primitive & 0xff) << 8 |
+            (denseId(passValues, packet.passValue) & 0xff);
+    }
+
+    auto& order{ renderQueue.order };
+    auto& sortScratch{ renderQueue.sortScratch };
+    order.resize(packets.size());
+    sortScratch.resize(packets.size());
+    std::iota(order.begin(), order.end(), 0);
+    for (size_t shift{ 0 }; shift < 64; shift += 8) {
+        std::array<size_t, 257> offsets{};
+        for (const auto& idx : order) ++offsets[((keys[idx] >> shift) & 0xff) + 1];
+        if (offsets[1] == order.size()) continue;  // every digit is zero
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        for (const auto& idx : order)
+            sortScratch[offsets[(keys[idx] >> shift) & 0xff]++] = idx;
+        std::swap(order, sortScratch);
+    }
+}
+
+bool isDrawStateEqual(const DrawPacket& a, const DrawPacket& b) {
+    return a.program == b.program && a.VAO == b.VAO &&
+        a.primitive == b.primitive && a.passLocation == b.passLocation &&
+        a.passValue == b.passValue;
+}
+
+const std::variant<SuccessResult<const GLuint>, ErrorResult> loadShaderProgram(
+    const std::span<const ShaderStage>& stages
+) {
+    std::vector<std::string> sources{};
+    for (const auto& stage : stages) {
+        const auto readFileResult{ readFile(stage.filename) };
+        if (std::holds_alternative<ErrorResult>(readFileResult))
+            return std::get<ErrorResult>(readFileResult);
+        sources.push_back(
+            std::get<SuccessResult<const std::string>>(readFileResult).value
+        );
+    }
+
+    // The driver strings are part of the key so a driver update never loads
+    // a stale binary.
+    std::string keySource{};
+    for (const auto& name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        keySource += (const char*)glGetString(name);
+        keySource += '\n';
+    }
+    for (size_t idx{ 0 }; idx < stages.size(); ++idx) {
+        keySource += std::to_string(stages[idx].type) + '\n' + sources[idx];
+    }
+    const auto key{ hashFnv1a(keySource) };
+
+    if (const auto cached{ shaderProgramCache.find(key) };
+        cached != shaderProgramCache.end())
+        return SuccessResult<const GLuint>{ cached->second };
+
+    std::stringstream cacheFilename;
+    cacheFilename << std::hex << key << ".bin";
+    const auto cacheFilePath{ shaderProgramCachePath / cacheFilename.str() };
+    const auto& binaryFunctions{ loadProgramBinaryFunctions() };
+
+    const auto shaderProgram{ glCreateProgram() };
+    if (binaryFunctions.has_value() &&
+        loadProgramBinary(*binaryFunctions, shaderProgram, cacheFilePath)) {
+        shaderProgramCache.emplace(key, shaderProgram);
+        return SuccessResult<const GLuint>{ shaderProgram };
+    }
+
+    std::vector<GLuint> shaders{};
+    for (size_t idx{ 0 }; idx < stages.size(); ++idx) {
+        const auto shaderSrc{ sources[idx].c_str() };
+        const auto shader{ glCreateShader(stages[idx].type) };
+        glShaderSource(shader, 1, &shaderSrc, nullptr);
+        glCompileShader(shader);
+        glAttachShader(shaderProgram, shader);
+        shaders.push_back(shader);
+    }
+
+    if (binaryFunctions.has_value()) {
+        binaryFunctions->programParameteri(
+            shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE
+        );
+    }
     glLinkProgram(shaderProgram);
 
-    glDeleteShader(shader);
+    for (const auto& shader : shaders) glDeleteShader(shader);
+
+    GLint linkStatus{ GL_FALSE };
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        std::array<GLchar, 1024> infoLog{};
+        glGetProgramInfoLog(shaderProgram, (GLsizei)infoLog.size(), nullptr,
+                            infoLog.data());
+        glDeleteProgram(shaderProgram);
+        return ErrorResult{
+            "Fail to link shader program: " + std::string(infoLog.data())
+        };
+    }
+
+    if (binaryFunctions.has_value())
+        saveProgramBinary(*binaryFunctions, shaderProgram, cacheFilePath);
+
+    shaderProgramCache.emplace(key, shaderProgram);
+    return SuccessResult<const GLuint>{ shaderProgram };
+}
+
+void cleanupShaderPrograms() {
+    for (const auto& [key, shaderProgram] : shaderProgramCache)
+        glDeleteProgram(shaderProgram);
+    shaderProgramCache.clear();
+}
+
+const std::optional<ProgramBinaryFunctions>& loadProgramBinaryFunctions() {
+    static const auto functions{ []() -> std::optional<ProgramBinaryFunctions> {
+        if (!isGlSupported(4, 1, "GL_ARB_get_program_binary"))
+            return std::nullopt;
+
+        GLint formatCount{};
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (formatCount <= 0) return std::nullopt;
+
+        const ProgramBinaryFunctions loaded{
+            .getProgramBinary{ (PFNGETPROGRAMBINARYPROC)
+                loadGlProc("glGetProgramBinary") },
+            .programBinary{ (PFNPROGRAMBINARYPROC)
+                loadGlProc("glProgramBinary") },
+            .programParameteri{ (PFNPROGRAMPARAMETERIPROC)
+                loadGlProc("glProgramParameteri") },
+        };
+        if (loaded.getProgramBinary == nullptr ||
+            loaded.programBinary == nullptr ||
+            loaded.programParameteri == nullptr) return std::nullopt;
+        return loaded;
+    }() };
+    return functions;
+}
+
+bool loadProgramBinary(const ProgramBinaryFunctions& functions,
+                       const GLuint& shaderProgram,
+                       const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    GLenum format{};
+    file.read((char*)&format, sizeof(format));
+    const std::vector<char> binary{ std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>() };
+    if (!file.good() && !file.eof()) return false;
+    if (binary.empty()) return false;
 
-    return SuccessResult<const GLuint>{shaderProgram};
+    functions.programBinary(shaderProgram, format, binary.data(),
+                            (GLsizei)binary.size());
+
+    GLint linkStatus{ GL_FALSE };
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+// The cache is best effort: failing to write it only costs the next start.
+void saveProgramBinary(const ProgramBinaryFunctions& functions,
+                       const GLuint& shaderProgram,
+                       const std::filesystem::path& path) {
+    GLint length{};
+    glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format{};
+    functions.getProgramBinary(shaderProgram, length, nullptr, &format,
+                               binary.data());
+
+    std::error_code errorCode{};
+    std::filesystem::create_directories(path.parent_path(), errorCode);
+    if (errorCode) return;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return;
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), binary.size());
+}
+
+bool isGlSupported(const GLint& major, const GLint& minor,
+                   const std::string& extension) {
+    GLint majorVersion{}, minorVersion{};
+    glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+    if (majorVersion > major || (majorVersion == major && minorVersion >= minor))
+        return true;
+
+    GLint extensionCount{};
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint idx{ 0 }; idx < extensionCount; ++idx) {
+        if (extension == (const char*)glGetStringi(GL_EXTENSIONS, idx))
+            return true;
+    }
+    return false;
+}
+
+void* loadGlProc(const char* name) {
+    return glProcLoader != nullptr ? glProcLoader(name) : nullptr;
+}
+
+uint64_t hashFnv1a(const std::string& data) {
+    uint64_t hash{ 0xcbf29ce484222325 };
+    for (const auto& byte : data) {
+        hash ^= (unsigned char)byte;
+        hash *= 0x100000001b3;
+    }
+    return hash;
 }
 
 const std::variant<SuccessResult<const std::string>, ErrorResult> readFile(
@@ -1,21 +1,116 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <span>
+#include <string>
 #include <variant>
+#include <vector>
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
 #include "result.h"
 
+// Offscreen context rendering into `framebuffer`, for machines without a
+// display. The EGL handles are opaque so EGL headers stay out of this file.
+struct HeadlessGl {
+    void* display;
+    void* context;
+    GLuint framebuffer;
+    GLuint colorRenderbuffer;
+};
+
+struct ShaderStage {
+    std::string filename;
+    GLenum type;
+};
+
 struct RenderObject {
     GLuint shaderProgram;
     GLuint VAO;
     GLuint VBO;
 };
 
+// Dynamic data streamed through regionCount copies of one region. Every region
+// is fenced after the draws that read it, and a write always goes to the
+// region the GPU released longest ago. The buffer stays persistently mapped
+// with GL_ARB_buffer_storage and is otherwise mapped unsynchronized for each
+// write, which GL 3.3 supports.
+struct StreamingBuffer {
+    static constexpr size_t regionCount{ 3 };
+
+    GLuint buffer;
+    GLsizeiptr regionSize;
+    size_t region;
+    std::array<GLsync, regionCount> fences;
+    GLbyte* persistentMapping;
+};
+
+// Elements edited on the CPU that are still stale in some streaming regions.
+struct DirtyInstances {
+    std::vector<uint8_t> pendingRegions;
+    std::vector<size_t> indices;
+};
+
+// One draw call and the state it needs. Packets are sorted by layer first, so
+// layers keep their submission order, and then by the state they bind.
+// `passValue` is written to the unsigned uniform at `passLocation`, if any.
+// Point size is not packet state: the shader sets it (GL_PROGRAM_POINT_SIZE).
+struct DrawPacket {
+    uint8_t layer;
+    GLuint program;
+    GLuint VAO;
+    GLenum primitive;
+    GLint passLocation;
+    GLuint passValue;
+    GLint first;
+    GLsizei count;
+    GLsizei instanceCount;
+};
+
+struct RenderQueueStats {
+    size_t packets;
+    size_t drawCalls;
+    size_t stateChanges;
+    // Compared with binding every packet's state before drawing it.
+    size_t stateChangesAvoided;
+};
+
+struct RenderQueue {
+    std::vector<DrawPacket> packets;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> sortScratch;
+    std::vector<GLint> multiDrawFirsts;
+    std::vector<GLsizei> multiDrawCounts;
+    RenderQueueStats stats;
+};
+
+enum TriangleInstanceFlag : GLuint {
+    TRIANGLE_INSTANCE_BORDER = 1 << 0,
+    TRIANGLE_INSTANCE_FILL = 1 << 1,
+};
+
+// Per-instance attributes of a triangle, laid out as read by triangle.vert.
+struct TriangleInstance {
+    float scale;
+    float rotateDeg;
+    float pointSize;
+    GLuint flags;
+    std::array<float, 4> color;
+};
+
 const std::variant<SuccessResult<GLFWwindow* const>, ErrorResult> initGl();
 
+// Creates a surfaceless EGL context, which Mesa's llvmpipe provides without a
+// display, and binds a width x height framebuffer object to draw into.
+const std::variant<SuccessResult<const HeadlessGl>, ErrorResult>
+initHeadlessGl(const GLsizei& width, const GLsizei& height);
+
+void cleanupHeadlessGl(const HeadlessGl& headlessGl);
+
+// `window` is nullptr for a headless context.
 void cleanupGl(
     GLFWwindow* const window,
     const std::span<const RenderObject>& renderObjects
@@ -24,8 +119,44 @@ void cleanupGl(
 void buildTriangleVertices(const RenderObject& renderObject,
                            const std::array<const glm::vec3, 3>& vertices);
 
-const std::variant<SuccessResult<const GLuint>, ErrorResult> attachShader(
-    const GLuint& shaderProgram,
-    const std::string& shaderFilename,
-    const GLenum& shaderType
-);
\ No newline at end of file
+void buildTriangleInstances(const RenderObject& renderObject,
+                            StreamingBuffer& streamingBuffer,
+                            const std::span<const TriangleInstance>& instances);
+
+// Points the instanced attributes at the current streaming region.
+void bindTriangleInstances(const RenderObject& renderObject,
+                           const StreamingBuffer& streamingBuffer);
+
+void initStreamingBuffer(StreamingBuffer& streamingBuffer,
+                         const GLsizeiptr& regionSize);
+
+void cleanupStreamingBuffer(StreamingBuffer& streamingBuffer);
+
+// Advances to the next region, waiting on its fence if needed, and returns a
+// write pointer to it. The previous contents of the region are preserved.
+GLbyte* beginStreamingBufferWrite(StreamingBuffer& streamingBuffer);
+
+void endStreamingBufferWrite(StreamingBuffer& streamingBuffer);
+
+// Fences the current region; call after the draws reading it.
+void fenceStreamingBuffer(StreamingBuffer& streamingBuffer);
+
+GLintptr streamingBufferOffset(const StreamingBuffer& streamingBuffer);
+
+void markInstanceDirty(DirtyInstances& dirtyInstances, const size_t& index);
+
+void submitDrawPacket(RenderQueue& renderQueue, const DrawPacket& packet);
+
+// Sorts the submitted packets, draws them with redundant state changes
+// removed and runs of compatible non-instanced draws merged into
+// glMultiDrawArrays, then empties the queue.
+void flushRenderQueue(RenderQueue& renderQueue);
+
+// Programs are deduplicated by their stage sources and cached on disk as
+// driver binaries when GL_ARB_get_program_binary is available. They are owned
+// by the cache and released by cleanupGl().
+const std::variant<SuccessResult<const GLuint>, ErrorResult> loadShaderProgram(
+    const std::span<const ShaderStage>& stages
+);
+
+void cleanupShaderPrograms();
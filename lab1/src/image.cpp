@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string>
+
+#include "image.h"
+
+void writePngRows(ImageWriter& writer, const std::span<const uint8_t>& rows,
+                  const GLsizei& rowCount);
+uint32_t updateCrc32(uint32_t crc, const std::span<const uint8_t>& bytes);
+void writePngChunk(std::ofstream& file, const char* type,
+                   const std::span<const uint8_t>& data);
+void appendBigEndian(std::vector<uint8_t>& bytes, const uint32_t& value);
+
+Image readFramebuffer(const GLsizei& width, const GLsizei& height) {
+    Image image{ .width{ width }, .height{ height } };
+    image.pixels.resize((size_t)width * height * 3);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+                 image.pixels.data());
+
+    // OpenGL returns the bottom row first.
+    const auto rowSize{ (size_t)width * 3 };
+    for (GLsizei row{ 0 }; row < height / 2; ++row) {
+        std::swap_ranges(
+            image.pixels.begin() + row * rowSize,
+            image.pixels.begin() + (row + 1) * rowSize,
+            image.pixels.begin() + (height - 1 - row) * rowSize
+        );
+    }
+    return image;
+}
+
+const std::variant<SuccessResult<const Image>, ErrorResult> readPpm(
+    const std::filesystem::path& path
+) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return ErrorResult{
+        "Fail to open file: " + path.string()
+    };
+
+    std::string magic{};
+    Image image{};
+    int maxValue{};
+    file >> magic >> image.width >> image.height >> maxValue;
+    file.get();  // the single whitespace before the raster
+    if (!file.good() || magic != "P6" || maxValue != 255 ||
+        image.width <= 0 || image.height <= 0) return ErrorResult{
+        "Unsupported PPM file: " + path.string()
+    };
+
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    file.read((char*)image.pixels.data(), image.pixels.size());
+    if (!file.good()) return ErrorResult{
+        "Truncated PPM file: " + path.string()
+    };
+    return SuccessResult<const Image>{ image };
+}
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+writePpm(const Image& image, const std::filesystem::path& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return ErrorResult{
+        "Fail to open file: " + path.string()
+    };
+
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write((const char*)image.pixels.data(), image.pixels.size());
+    if (!file.good()) return ErrorResult{
+        "Fail to write file: " + path.string()
+    };
+    return SuccessResult<const std::filesystem::path>{ path };
+}
+
+const std::variant<SuccessResult<const ImageDiff>, ErrorResult> compareImages(
+    const Image& actual,
+    const Image& expected,
+    const uint8_t& tolerance
+) {
+    if (actual.width != expected.width || actual.height != expected.height)
+        return ErrorResult{
+            "Image size mismatch: " + std::to_string(actual.width) + "x" +
+            std::to_string(actual.height) + " vs " +
+            std::to_string(expected.width) + "x" +
+            std::to_string(expected.height)
+        };
+
+    ImageDiff diff{};
+    for (size_t idx{ 0 }; idx < actual.pixels.size(); idx += 3) {
+        uint8_t pixelDifference{ 0 };
+        for (size_t channel{ 0 }; channel < 3; ++channel) {
+            const auto a{ actual.pixels[idx + channel] };
+            const auto b{ expected.pixels[idx + channel] };
+            pixelDifference = std::max(pixelDifference,
+                                       (uint8_t)(a > b ? a - b : b - a));
+        }
+        diff.maxDifference = std::max(diff.maxDifference, pixelDifference);
+        if (pixelDifference > tolerance) ++diff.mismatchedPixels;
+    }
+    return SuccessResult<const ImageDiff>{ diff };
+}
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startImageWriter(ImageWriter& writer,
+                 const std::filesystem::path& path,
+                 const GLsizei& width,
+                 const GLsizei& height) {
+    writer.file.open(path, std::ios::binary | std::ios::trunc);
+    if (!writer.file.is_open()) return ErrorResult{
+        "Fail to open file: " + path.string()
+    };
+
+    writer.png = path.extension() == ".png";
+    writer.width = width;
+    writer.height = height;
+    writer.rowsWritten = 0;
+    writer.adlerA = 1;
+    writer.adlerB = 0;
+    if (writer.png) {
+        const std::array<const uint8_t, 8> signature{
+            0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+        };
+        writer.file.write((const char*)signature.data(), signature.size());
+
+        // 8-bit RGB, no interlacing.
+        std::vector<uint8_t> header{};
+        appendBigEndian(header, width);
+        appendBigEndian(header, height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 });
+        writePngChunk(writer.file, "IHDR", header);
+    } else {
+        writer.file << "P6\n" << width << " " << height << "\n255\n";
+    }
+
+    if (!writer.file.good()) return ErrorResult{
+        "Fail to write file: " + path.string()
+    };
+    return SuccessResult<const std::filesystem::path>{
+        std::filesystem::absolute(path)
+    };
+}
+
+// The file is complete once the last row has been written.
+const std::variant<SuccessResult<const GLsizei>, ErrorResult> writeImageRows(
+    ImageWriter& writer,
+    const std::span<const uint8_t>& rows
+) {
+    const auto rowSize{ (size_t)writer.width * 3 };
+    const auto rowCount{ (GLsizei)(rows.size() / rowSize) };
+    if (rows.size() % rowSize != 0 ||
+        writer.rowsWritten + rowCount > writer.height) return ErrorResult{
+        "Rows do not fit the image"
+    };
+
+    if (!writer.png) {
+        writer.file.write((const char*)rows.data(), rows.size());
+    } else {
+        writePngRows(writer, rows, rowCount);
+    }
+
+    writer.rowsWritten += rowCount;
+    if (writer.rowsWritten == writer.height) writer.file.close();
+    if (writer.file.fail()) return ErrorResult{ "Fail to write image rows" };
+    return SuccessResult<const GLsizei>{ writer.rowsWritten };
+}
+
+// Streams the rows as one IDAT chunk of stored deflate blocks, without
+// copying them into a separate buffer first.
+void writePngRows(ImageWriter& writer, const std::span<const uint8_t>& rows,
+                  const GLsizei& rowCount) {
+    const auto rowSize{ (size_t)writer.width * 3 };
+    const auto isFirst{ writer.rowsWritten == 0 };
+    const auto isLast{ writer.rowsWritten + rowCount == writer.height };
+
+    // Each scanline starts with filter type 0 (none).
+    const size_t maxBlockSize{ 65535 };
+    const auto streamSize{ (size_t)rowCount * (rowSize + 1) };
+    const auto blockCount{ (streamSize + maxBlockSize - 1) / maxBlockSize };
+    const auto chunkSize{
+        (isFirst ? 2 : 0) + 5 * blockCount + streamSize + (isLast ? 4 : 0)
+    };
+
+    std::vector<uint8_t> header{};
+    appendBigEndian(header, (uint32_t)chunkSize);
+    header.insert(header.end(), { 'I', 'D', 'A', 'T' });
+    writer.file.write((const char*)header.data(), header.size());
+    auto crc{
+        updateCrc32(0xffffffff, std::span<const uint8_t>(header).subspan(4))
+    };
+    const auto put{ [&](const std::span<const uint8_t>& bytes) {
+        writer.file.write((const char*)bytes.data(), bytes.size());
+        crc = updateCrc32(crc, bytes);
+    } };
+
+    if (isFirst) put(std::array<const uint8_t, 2>{ 0x78, 0x01 });
+
+    size_t streamOffset{ 0 };
+    size_t blockLeft{ 0 };
+    const auto putStream{ [&](std::span<const uint8_t> bytes) {
+        while (!bytes.empty()) {
+            if (blockLeft == 0) {
+                blockLeft = std::min(maxBlockSize, streamSize - streamOffset);
+                const auto isFinal{
+                    isLast && streamOffset + blockLeft == streamSize
+                };
+                put(std::array<const uint8_t, 5>{
+                    (uint8_t)(isFinal ? 1 : 0),
+                    (uint8_t)(blockLeft & 0xff),
+                    (uint8_t)(blockLeft >> 8),
+                    (uint8_t)(~blockLeft & 0xff),
+                    (uint8_t)((~blockLeft >> 8) & 0xff)
+                });
+            }
+            const auto count{ std::min(blockLeft, bytes.size()) };
+            put(bytes.first(count));
+            for (const auto& byte : bytes.first(count)) {
+                writer.adlerA = (writer.adlerA + byte) % 65521;
+                writer.adlerB = (writer.adlerB + writer.adlerA) % 65521;
+            }
+            bytes = bytes.subspan(count);
+            blockLeft -= count;
+            streamOffset += count;
+        }
+    } };
+    const std::array<const uint8_t, 1> filter{ 0 };
+    for (GLsizei row{ 0 }; row < rowCount; ++row) {
+        putStream(filter);
+        putStream(rows.subspan(row * rowSize, rowSize));
+    }
+
+    std::vector<uint8_t> footer{};
+    if (isLast) {
+        appendBigEndian(footer, writer.adlerB << 16 | writer.adlerA);
+        put(footer);
+        footer.clear();
+    }
+    appendBigEndian(footer, crc ^ 0xffffffff);
+    writer.file.write((const char*)footer.data(), footer.size());
+
+    if (isLast) writePngChunk(writer.file, "IEND", {});
+}
+
+uint32_t updateCrc32(uint32_t crc, const std::span<const uint8_t>& bytes) {
+    static const auto table{ []() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t idx{ 0 }; idx < table.size(); ++idx) {
+            auto value{ idx };
+            for (size_t bit{ 0 }; bit < 8; ++bit)
+                value = value & 1 ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            table[idx] = value;
+        }
+        return table;
+    }() };
+    for (const auto& byte : bytes)
+        crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+void writePngChunk(std::ofstream& file, const char* type,
+                   const std::span<const uint8_t>& data) {
+    std::vector<uint8_t> header{};
+    appendBigEndian(header, (uint32_t)data.size());
+    header.insert(header.end(), type, type + 4);
+    file.write((const char*)header.data(), header.size());
+    file.write((const char*)data.data(), data.size());
+
+    const auto crc{ updateCrc32(
+        updateCrc32(0xffffffff,
+                    std::span<const uint8_t>(header).subspan(4)),
+        data
+    ) ^ 0xffffffff };
+    std::vector<uint8_t> footer{};
+    appendBigEndian(footer, crc);
+    file.write((const char*)footer.data(), footer.size());
+}
+
+void appendBigEndian(std::vector<uint8_t>& bytes, const uint32_t& value) {
+    bytes.insert(bytes.end(), {
+        (uint8_t)(value >> 24), (uint8_t)(value >> 16),
+        (uint8_t)(value >> 8), (uint8_t)value
+    });
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "result.h"
+
+// Tightly packed 8-bit RGB pixels, top row first.
+struct Image {
+    GLsizei width;
+    GLsizei height;
+    std::vector<uint8_t> pixels;
+};
+
+// Writes an image a band of rows at a time, so it never has to fit in memory.
+// PNG output uses uncompressed deflate blocks; PPM is used for any other
+// extension.
+struct ImageWriter {
+    std::ofstream file;
+    bool png;
+    GLsizei width;
+    GLsizei height;
+    GLsizei rowsWritten;
+    // Running Adler-32 of the PNG zlib stream.
+    uint32_t adlerA;
+    uint32_t adlerB;
+};
+
+struct ImageDiff {
+    size_t mismatchedPixels;
+    uint8_t maxDifference;
+};
+
+// Reads the color buffer of the bound read framebuffer.
+Image readFramebuffer(const GLsizei& width, const GLsizei& height);
+
+const std::variant<SuccessResult<const Image>, ErrorResult> readPpm(
+    const std::filesystem::path& path
+);
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+writePpm(const Image& image, const std::filesystem::path& path);
+
+// A pixel mismatches when any channel differs by more than `tolerance`.
+const std::variant<SuccessResult<const ImageDiff>, ErrorResult> compareImages(
+    const Image& actual,
+    const Image& expected,
+    const uint8_t& tolerance
+);
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startImageWriter(ImageWriter& writer,
+                 const std::filesystem::path& path,
+                 const GLsizei& width,
+                 const GLsizei& height);
+
+// `rows` holds whole 8-bit RGB rows, top row first.
+const std::variant<SuccessResult<const GLsizei>, ErrorResult> writeImageRows(
+    ImageWriter& writer,
+    const std::span<const uint8_t>& rows
+);
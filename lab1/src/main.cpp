@@ -1,8 +1,15 @@
 #include <array>
 #include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
 #include <numeric>
+#include <optional>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -17,106 +24,582 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include "capture.h"
 #include "gl.h"
+#include "image.h"
+#include "picking.h"
+#include "poster.h"
+#include "profiler.h"
+
+struct Options {
+    bool headless;
+    std::optional<uint64_t> frames;
+    std::optional<std::filesystem::path> dumpPath;
+    std::optional<std::filesystem::path> goldenPath;
+    std::optional<std::filesystem::path> capturePath;
+    std::optional<std::filesystem::path> posterPath;
+    GLsizei posterSize;
+    uint8_t tolerance;
+    size_t captureMemoryMiB;
+};
 
-struct Triangle {
+struct TriangleStyle {
     bool border;
     bool fill;
     float pointSize;
-    float scale;
-    float rotateDeg;
     std::array<float, 4> color;
-    RenderObject renderObject;
 };
 
-template<size_t N>
-std::array<Triangle, N> initializeTriangles();
+// Scale and rotation are read for every triangle on each pick, so they are
+// kept in their own arrays apart from the rest of the triangle.
+struct Triangles {
+    std::vector<float> scales;
+    std::vector<float> rotateDegs;
+    std::vector<TriangleStyle> styles;
+};
+
+// Triangles selected in the list or the viewport; edits apply to all of them.
+// The last selected one is shown in the editor.
+struct TriangleSelection {
+    std::vector<uint32_t> indices;
+    // Position of every triangle in `indices` plus one, 0 when not selected.
+    std::vector<uint32_t> positions;
+    // Row a shift-click extends the selection from.
+    size_t anchorRow;
+};
+
+// Lists the triangles within a scale range and, optionally, close to a color.
+// Matches are only rebuilt when the filter or a triangle changes.
+struct TriangleFilter {
+    float minScale;
+    float maxScale;
+    bool byColor;
+    std::array<float, 3> color;
+    float colorTolerance;
+
+    bool dirty;
+    std::vector<uint64_t> matchBits;
+    // Ascending triangle indices.
+    std::vector<uint32_t> matches;
+};
+
+// What the editor changed in a frame. Scale, rotation and pickability move
+// triangles in the pick index; scale and color change the filter matches.
+// `finished` is set once no widget is held, so a drag has ended.
+struct TriangleEdit {
+    bool instances;
+    bool pickIndex;
+    bool filter;
+    bool finished;
+};
+
+constexpr float maxTriangleScale{ 4.0f };
+
+Triangles initializeTriangles(const size_t& count);
+const std::variant<SuccessResult<const RenderObject>, ErrorResult>
+initializeTriangleRenderObject(const Triangles& triangles,
+                               StreamingBuffer& instanceBuffer);
+TriangleInstance toTriangleInstance(const Triangles& triangles,
+                                    const size_t& idx);
+bool isPickable(const Triangles& triangles, const size_t& idx);
+void initializePickIndex(PickIndex& pickIndex, const Triangles& triangles);
+void updateEditedTriangles(const TriangleEdit& edit, TriangleEdit& pendingEdit,
+                           PickIndex& pickIndex, DirtyInstances& dirtyTriangles,
+                           TriangleFilter& filter, const Triangles& triangles,
+                           const TriangleSelection& selection);
+void uploadDirtyTriangles(const RenderObject& renderObject,
+                          StreamingBuffer& instanceBuffer,
+                          DirtyInstances& dirtyTriangles,
+                          const Triangles& triangles);
 void initializeImGui(GLFWwindow* window);
-void renderGl(const std::span<const Triangle>& triangles, const bool& animate);
-void renderGui(const std::span<Triangle>& triangles, bool& animate);
+void renderGl(const RenderObject& renderObject, const GLsizei& instanceCount,
+              const float& rotateDegOffset, const glm::mat4& projection,
+              const float& pointScale, RenderQueue& renderQueue);
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+renderTrianglePoster(const Options& options, const GLsizei& windowSize,
+                     const RenderObject& renderObject,
+                     const Triangles& triangles, const float& rotateDegOffset,
+                     RenderQueue& renderQueue);
+void selectOnly(TriangleSelection& selection, const uint32_t& idx);
+void toggleSelected(TriangleSelection& selection, const uint32_t& idx);
+bool isFilterActive(const TriangleFilter& filter);
+void updateTriangleFilter(TriangleFilter& filter, const Triangles& triangles,
+                          const PickIndex& pickIndex);
+TriangleEdit renderGui(Triangles& triangles, TriangleSelection& selection,
+                       TriangleFilter& filter, const PickIndex& pickIndex,
+                       const float& rotateDegOffset, bool& animate,
+                       FrameProfiler& profiler,
+                       const RenderQueueStats& renderStats);
+void renderTriangleList(const Triangles& triangles,
+                        TriangleSelection& selection, TriangleFilter& filter,
+                        const PickIndex& pickIndex);
+TriangleEdit renderTriangleEditor(Triangles& triangles,
+                                  const TriangleSelection& selection);
 static void KbdCallback(GLFWwindow* window, int key, int scancode, int action,
                         int mods);
-
-int main() {
-    const auto initGlResult{ initGl() };
-    if (std::holds_alternative<ErrorResult>(initGlResult)) {
-        std::cout << std::get<ErrorResult>(initGlResult).message << std::endl;
+const std::variant<SuccessResult<const Options>, ErrorResult> parseOptions(
+    const std::span<char* const>& args
+);
+int checkLastFrame(const Options& options, const Image& lastFrame);
+
+int main(int argc, char* argv[]) {
+    const auto parseOptionsResult{
+        parseOptions(std::span<char* const>(argv + 1, argv + argc))
+    };
+    if (std::holds_alternative<ErrorResult>(parseOptionsResult)) {
+        std::cout << std::get<ErrorResult>(parseOptionsResult).message
+                  << std::endl;
         return -1;
     }
-
-    const auto window{
-        std::get<SuccessResult<GLFWwindow* const>>(initGlResult).value
+    const auto options{
+        std::get<SuccessResult<const Options>>(parseOptionsResult).value
     };
 
-    glViewport(0, 0, 800, 800);
+    const GLsizei windowSize{ 800 };
+    GLFWwindow* window{ nullptr };
+    std::optional<HeadlessGl> headlessGl{};
+    if (options.headless) {
+        const auto initHeadlessGlResult{
+            initHeadlessGl(windowSize, windowSize)
+        };
+        if (std::holds_alternative<ErrorResult>(initHeadlessGlResult)) {
+            std::cout << std::get<ErrorResult>(initHeadlessGlResult).message
+                      << std::endl;
+            return -1;
+        }
+        headlessGl =
+            std::get<SuccessResult<const HeadlessGl>>(initHeadlessGlResult)
+                .value;
+    } else {
+        const auto initGlResult{ initGl() };
+        if (std::holds_alternative<ErrorResult>(initGlResult)) {
+            std::cout << std::get<ErrorResult>(initGlResult).message
+                      << std::endl;
+            return -1;
+        }
+        window = std::get<SuccessResult<GLFWwindow* const>>(initGlResult).value;
+    }
+    const auto cleanup{ [&](const std::span<const RenderObject>& renderObjects) {
+        cleanupGl(window, renderObjects);
+        if (headlessGl.has_value()) cleanupHeadlessGl(headlessGl.value());
+    } };
+
+    glViewport(0, 0, windowSize, windowSize);
+    glEnable(GL_PROGRAM_POINT_SIZE);
 
     const GLsizei size{ 100 };
-    auto triangles{ initializeTriangles<size>() };
+    auto triangles{ initializeTriangles(size) };
+    StreamingBuffer instanceBuffer{};
+    DirtyInstances dirtyTriangles{};
+    const auto initializeRenderObjectResult{
+        initializeTriangleRenderObject(triangles, instanceBuffer)
+    };
+    if (std::holds_alternative<ErrorResult>(initializeRenderObjectResult)) {
+        std::cout << std::get<ErrorResult>(initializeRenderObjectResult).message
+                  << std::endl;
+        cleanup({});
+        return -1;
+    }
+    const auto renderObject{
+        std::get<SuccessResult<const RenderObject>>(
+            initializeRenderObjectResult
+        ).value
+    };
     bool animate{ true };
+    RenderQueue renderQueue{};
+    PickIndex pickIndex{};
+    initializePickIndex(pickIndex, triangles);
+    TriangleSelection selection{
+        .positions = std::vector<uint32_t>(triangles.styles.size())
+    };
+    selectOnly(selection, 0);
+    TriangleFilter filter{
+        .maxScale{ maxTriangleScale },
+        .color{ 1.0f, 1.0f, 1.0f },
+        .colorTolerance{ 0.25f },
+    };
+
+    FrameProfiler profiler{};
+    initProfiler(profiler);
+
+    FrameCapture capture{};
+    if (options.capturePath.has_value()) {
+        const auto startCaptureResult{ startFrameCapture(
+            capture, options.capturePath.value(), windowSize, windowSize,
+            options.captureMemoryMiB << 20
+        ) };
+        if (std::holds_alternative<ErrorResult>(startCaptureResult)) {
+            std::cout << std::get<ErrorResult>(startCaptureResult).message
+                      << std::endl;
+            cleanupProfiler(profiler);
+            cleanupStreamingBuffer(instanceBuffer);
+            const std::array<const RenderObject, 1> renderObjects{
+                renderObject
+            };
+            cleanup(renderObjects);
+            return -1;
+        }
+    }
 
     // Set background color
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
-    initializeImGui(window);
+    if (window != nullptr) {
+        initializeImGui(window);
+        glfwSetKeyCallback(window, KbdCallback);
+    }
+
+    std::optional<Image> lastFrame{};
+    float lastRotateDegOffset{ 0.0f };
+    TriangleEdit pendingEdit{};
+    for (uint64_t frame{ 0 };; ++frame) {
+        if (options.frames.has_value() && frame >= options.frames.value())
+            break;
+        if (window != nullptr && glfwWindowShouldClose(window)) break;
+
+        // A fixed time step makes a run of N frames reproducible.
+        const auto time{
+            options.frames.has_value() ? frame / 60.0f : (float)glfwGetTime()
+        };
+        const auto rotateDegOffset{ animate ? time : 0.0f };
+        lastRotateDegOffset = rotateDegOffset;
+
+        beginProfilerFrame(profiler);
+        {
+            const ProfilerScope scope{ profiler, PROFILER_STAGE_GL };
+            uploadDirtyTriangles(renderObject, instanceBuffer, dirtyTriangles,
+                                 triangles);
+            renderGl(renderObject, size, rotateDegOffset, glm::mat4{ 1.0f },
+                     1.0f, renderQueue);
+            fenceStreamingBuffer(instanceBuffer);
+            const auto stalledFrames{ capture.stalledFrames };
+            captureFrame(capture);
+            if (stalledFrames == 0 && capture.stalledFrames != 0) {
+                std::cout << "Capture memory is full, rendering waits for "
+                             "the disk to keep every frame" << std::endl;
+            }
+        }
+
+        // Captured before the GUI so the image only depends on the scene.
+        if (options.frames.has_value() && frame + 1 == options.frames.value())
+            lastFrame = readFramebuffer(windowSize, windowSize);
+
+        if (window != nullptr) {
+            TriangleEdit edit{};
+            {
+                const ProfilerScope scope{ profiler, PROFILER_STAGE_GUI };
+                edit = renderGui(triangles, selection, filter, pickIndex,
+                                 rotateDegOffset, animate, profiler,
+                                 renderQueue.stats);
+            }
+            updateEditedTriangles(edit, pendingEdit, pickIndex, dirtyTriangles,
+                                  filter, triangles, selection);
+
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        endProfilerFrame(profiler);
+    }
+
+    auto exitCode{
+        lastFrame.has_value() ? checkLastFrame(options, lastFrame.value()) : 0
+    };
+
+    if (options.posterPath.has_value()) {
+        const auto posterResult{ renderTrianglePoster(
+            options, windowSize, renderObject, triangles, lastRotateDegOffset,
+            renderQueue
+        ) };
+        if (std::holds_alternative<ErrorResult>(posterResult)) {
+            std::cout << std::get<ErrorResult>(posterResult).message
+                      << std::endl;
+            exitCode = -1;
+        } else {
+            std::cout << "Rendered poster to "
+                      << std::get<
+                             SuccessResult<const std::filesystem::path>
+                         >(posterResult).value.string()
+                      << std::endl;
+        }
+    }
+
+    const auto stopCaptureResult{ stopFrameCapture(capture) };
+    if (std::holds_alternative<ErrorResult>(stopCaptureResult)) {
+        std::cout << std::get<ErrorResult>(stopCaptureResult).message
+                  << std::endl;
+        exitCode = -1;
+    } else if (options.capturePath.has_value()) {
+        std::cout << "Captured "
+                  << std::get<SuccessResult<const uint64_t>>(
+                         stopCaptureResult
+                     ).value
+                  << " frames to " << options.capturePath.value().string()
+                  << std::endl;
+        if (capture.droppedFrames != 0) {
+            std::cout << capture.droppedFrames
+                      << " frames could not be read back and were skipped"
+                      << std::endl;
+        }
+    }
 
-    glfwSetKeyCallback(window, KbdCallback);
+    cleanupProfiler(profiler);
+    cleanupStreamingBuffer(instanceBuffer);
+    const std::array<const RenderObject, 1> renderObjects{ renderObject };
+    cleanup(renderObjects);
+    return exitCode;
+}
 
-    while (!glfwWindowShouldClose(window)) {
-        renderGl(triangles, animate);
-        renderGui(triangles, animate);
+const std::variant<SuccessResult<const Options>, ErrorResult> parseOptions(
+    const std::span<char* const>& args
+) {
+    const std::string usage{
+        "Usage: lab1 [--headless] [--frames N] [--dump out.ppm]"
+        " [--golden golden.ppm] [--tolerance T] [--capture out.y4m]"
+        " [--capture-memory MiB] [--poster out.png] [--poster-size N]"
+    };
+    const auto parseNumber{ [](const std::string& arg, auto& value) {
+        const auto [end, error]{
+            std::from_chars(arg.data(), arg.data() + arg.size(), value)
+        };
+        return error == std::errc{} && end == arg.data() + arg.size();
+    } };
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    Options options{
+        .posterSize{ 8192 }, .tolerance{ 2 }, .captureMemoryMiB{ 256 }
+    };
+    for (size_t idx{ 0 }; idx < args.size(); ++idx) {
+        const std::string arg{ args[idx] };
+        if (arg == "--headless") {
+            options.headless = true;
+            continue;
+        }
+
+        if (idx + 1 >= args.size()) return ErrorResult{ usage };
+        const std::string value{ args[++idx] };
+        if (arg == "--frames") {
+            uint64_t frames{};
+            if (!parseNumber(value, frames) || frames == 0)
+                return ErrorResult{ "Invalid frame count: " + value };
+            options.frames = frames;
+        } else if (arg == "--dump") {
+            options.dumpPath = value;
+        } else if (arg == "--golden") {
+            options.goldenPath = value;
+        } else if (arg == "--capture") {
+            options.capturePath = value;
+        } else if (arg == "--capture-memory") {
+            if (!parseNumber(value, options.captureMemoryMiB) ||
+                options.captureMemoryMiB == 0 ||
+                options.captureMemoryMiB > (SIZE_MAX >> 20))
+                return ErrorResult{ "Invalid capture memory: " + value };
+        } else if (arg == "--poster") {
+            options.posterPath = value;
+        } else if (arg == "--poster-size") {
+            if (!parseNumber(value, options.posterSize) ||
+                options.posterSize <= 0)
+                return ErrorResult{ "Invalid poster size: " + value };
+        } else if (arg == "--tolerance") {
+            if (!parseNumber(value, options.tolerance))
+                return ErrorResult{ "Invalid tolerance: " + value };
+        } else {
+            return ErrorResult{ usage };
+        }
     }
 
-    std::array<RenderObject, triangles.size()> renderObjects{};
-    std::transform(triangles.begin(), triangles.end(), renderObjects.begin(),
-                   [](const auto& triangle) { return triangle.renderObject; });
-    cleanupGl(window, renderObjects);
-    return 0;
+    // Without a window there is nothing to close, so stop after one frame.
+    if (options.headless && !options.frames.has_value()) options.frames = 1;
+    return SuccessResult<const Options>{ options };
 }
 
-template<size_t N>
-std::array<Triangle, N> initializeTriangles() {
-    std::array<Triangle, N> triangles{};
-    std::array<int, N> indices{};
+// Writes and compares the last frame as requested; returns the exit code.
+int checkLastFrame(const Options& options, const Image& lastFrame) {
+    if (options.dumpPath.has_value()) {
+        const auto writeResult{
+            writePpm(lastFrame, options.dumpPath.value())
+        };
+        if (std::holds_alternative<ErrorResult>(writeResult)) {
+            std::cout << std::get<ErrorResult>(writeResult).message
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    if (!options.goldenPath.has_value()) return 0;
+
+    const auto readResult{ readPpm(options.goldenPath.value()) };
+    if (std::holds_alternative<ErrorResult>(readResult)) {
+        std::cout << std::get<ErrorResult>(readResult).message << std::endl;
+        return -1;
+    }
+    const auto compareResult{ compareImages(
+        lastFrame,
+        std::get<SuccessResult<const Image>>(readResult).value,
+        options.tolerance
+    ) };
+    if (std::holds_alternative<ErrorResult>(compareResult)) {
+        std::cout << std::get<ErrorResult>(compareResult).message << std::endl;
+        return -1;
+    }
+
+    const auto diff{
+        std::get<SuccessResult<const ImageDiff>>(compareResult).value
+    };
+    std::cout << diff.mismatchedPixels << " pixels differ by more than "
+              << (int)options.tolerance << " (max difference "
+              << (int)diff.maxDifference << ")" << std::endl;
+    return diff.mismatchedPixels == 0 ? 0 : 1;
+}
+
+Triangles initializeTriangles(const size_t& count) {
+    Triangles triangles{
+        .scales = std::vector<float>(count),
+        .rotateDegs = std::vector<float>(count),
+        .styles = std::vector<TriangleStyle>(count),
+    };
+    std::vector<int> indices(count);
     std::iota(indices.begin(), indices.end(), 0);
+    std::transform(indices.begin(), indices.end(), triangles.scales.begin(),
+                   [](const auto& idx) { return 3.25f - (0.0325f * idx); });
     std::transform(
-        indices.begin(), indices.end(), triangles.begin(),
-        [](const auto& idx) { return Triangle{
+        indices.begin(), indices.end(), triangles.rotateDegs.begin(),
+        [](const auto& idx) { return std::fmod(5.0f * idx, 360.0f); }
+    );
+    std::transform(
+        indices.begin(), indices.end(), triangles.styles.begin(),
+        [](const auto& idx) { return TriangleStyle{
             .border{ true },
             .fill{ true },
             .pointSize { 20.0f / (idx + 1)},
-            .scale{ 3.25f - (0.0325f * idx) },
-            .rotateDeg{std::fmod(5.0f * idx, 360.0f)},
             .color{
                 (float)(std::abs(std::sin(idx))),
                 (float)(std::abs(std::cos(idx + 0.5))),
                 (float)(std::abs(std::cos(idx))),
                 1.0f
-            },
-            .renderObject {.shaderProgram{ glCreateProgram() }}
+            }
         }; });
 
-    for (auto& triangle : triangles) {
-        attachShader(triangle.renderObject.shaderProgram,
-                     "triangle.vert", GL_VERTEX_SHADER);
-        attachShader(triangle.renderObject.shaderProgram,
-                     "triangle.frag", GL_FRAGMENT_SHADER);
-        glGenVertexArrays(1, &triangle.renderObject.VAO);
-        glGenBuffers(1, &triangle.renderObject.VBO);
+    return triangles;
+}
 
-        const float k{ 0.5f };
+// All triangles share one program and one VAO holding the unit triangle; the
+// per-triangle properties are instanced attributes.
+const std::variant<SuccessResult<const RenderObject>, ErrorResult>
+initializeTriangleRenderObject(const Triangles& triangles,
+                               StreamingBuffer& instanceBuffer) {
+    const std::array<const ShaderStage, 2> stages{
+        ShaderStage{ "triangle.vert", GL_VERTEX_SHADER },
+        ShaderStage{ "triangle.frag", GL_FRAGMENT_SHADER },
+    };
+    const auto loadShaderProgramResult{ loadShaderProgram(stages) };
+    if (std::holds_alternative<ErrorResult>(loadShaderProgramResult))
+        return std::get<ErrorResult>(loadShaderProgramResult);
+
+    RenderObject renderObject{
+        .shaderProgram{
+            std::get<SuccessResult<const GLuint>>(
+                loadShaderProgramResult
+            ).value
+        }
+    };
+    glGenVertexArrays(1, &renderObject.VAO);
+    glGenBuffers(1, &renderObject.VBO);
 
-        const std::array<const glm::vec3, 3> vertices{
-            glm::vec3{ -k, -k, 0.0f },
-            glm::vec3{ k, -k, 0.0f },
-            glm::vec3{ 0,  k, 0.0f },
-        };
-        buildTriangleVertices(triangle.renderObject, vertices);
+    const float k{ 0.5f };
+
+    const std::array<const glm::vec3, 3> vertices{
+        glm::vec3{ -k, -k, 0.0f },
+        glm::vec3{ k, -k, 0.0f },
+        glm::vec3{ 0,  k, 0.0f },
+    };
+    buildTriangleVertices(renderObject, vertices);
+
+    std::vector<TriangleInstance> instances(triangles.styles.size());
+    for (size_t idx{ 0 }; idx < instances.size(); ++idx)
+        instances[idx] = toTriangleInstance(triangles, idx);
+    buildTriangleInstances(renderObject, instanceBuffer, instances);
+
+    return SuccessResult<const RenderObject>{ renderObject };
+}
+
+TriangleInstance toTriangleInstance(const Triangles& triangles,
+                                    const size_t& idx) {
+    const auto& style{ triangles.styles[idx] };
+    return TriangleInstance{
+        .scale{ triangles.scales[idx] },
+        .rotateDeg{ triangles.rotateDegs[idx] },
+        .pointSize{ style.pointSize },
+        .flags{
+            (style.border ? TRIANGLE_INSTANCE_BORDER : 0u) |
+            (style.fill ? TRIANGLE_INSTANCE_FILL : 0u)
+        },
+        .color{ style.color }
+    };
+}
+
+// Triangles drawn neither filled nor bordered cannot be picked.
+bool isPickable(const Triangles& triangles, const size_t& idx) {
+    const auto& style{ triangles.styles[idx] };
+    return style.border || style.fill;
+}
+
+void initializePickIndex(PickIndex& pickIndex, const Triangles& triangles) {
+    std::vector<uint8_t> pickable(triangles.styles.size());
+    for (size_t idx{ 0 }; idx < pickable.size(); ++idx)
+        pickable[idx] = isPickable(triangles, idx);
+    buildPickIndex(pickIndex, triangles.scales, triangles.rotateDegs,
+                   pickable);
+}
+
+// Edited triangles are uploaded every frame. Re-sorting the pick index for a
+// large selection and refiltering cost O(N), so they wait in `pendingEdit`
+// until the edit is finished instead of running on every frame of a drag.
+// Until then picking and the list see the triangles as they were.
+void updateEditedTriangles(const TriangleEdit& edit, TriangleEdit& pendingEdit,
+                           PickIndex& pickIndex, DirtyInstances& dirtyTriangles,
+                           TriangleFilter& filter, const Triangles& triangles,
+                           const TriangleSelection& selection) {
+    if (edit.instances) {
+        for (const auto& idx : selection.indices)
+            markInstanceDirty(dirtyTriangles, idx);
     }
 
-    return triangles;
+    // Moving entries one by one costs up to O(N) each, so a large batch
+    // re-sorts the whole index instead.
+    if (edit.pickIndex && selection.indices.size() <= 1024) {
+        for (const auto& idx : selection.indices) {
+            updatePickIndex(pickIndex, idx, triangles.scales[idx],
+                            triangles.rotateDegs[idx],
+                            isPickable(triangles, idx));
+        }
+    } else {
+        pendingEdit.pickIndex |= edit.pickIndex;
+    }
+    pendingEdit.filter |= edit.filter;
+    if (!edit.finished) return;
+
+    if (pendingEdit.pickIndex) initializePickIndex(pickIndex, triangles);
+    filter.dirty |= pendingEdit.filter;
+    pendingEdit = TriangleEdit{};
+}
+
+// Copies only the edited triangles, into the next streaming region, until
+// every region has caught up with them.
+void uploadDirtyTriangles(const RenderObject& renderObject,
+                          StreamingBuffer& instanceBuffer,
+                          DirtyInstances& dirtyTriangles,
+                          const Triangles& triangles) {
+    if (dirtyTriangles.indices.empty()) return;
+
+    const auto instances{
+        (TriangleInstance*)beginStreamingBufferWrite(instanceBuffer)
+    };
+    std::erase_if(dirtyTriangles.indices, [&](const auto& idx) {
+        instances[idx] = toTriangleInstance(triangles, idx);
+        return --dirtyTriangles.pendingRegions[idx] == 0;
+    });
+    endStreamingBufferWrite(instanceBuffer);
+
+    bindTriangleInstances(renderObject, instanceBuffer);
 }
 
 void initializeImGui(GLFWwindow* window) {
@@ -129,45 +612,86 @@ void initializeImGui(GLFWwindow* window) {
     ImGui_ImplOpenGL3_Init("#version 330");
 }
 
-void renderGl(const std::span<const Triangle>& triangles, const bool& animate) {
+void renderGl(const RenderObject& renderObject, const GLsizei& instanceCount,
+              const float& rotateDegOffset, const glm::mat4& projection,
+              const float& pointScale, RenderQueue& renderQueue) {
     glClear(GL_COLOR_BUFFER_BIT);
 
-    for (const auto& triangle : triangles) {
-        glUseProgram(triangle.renderObject.shaderProgram);
-        glBindVertexArray(triangle.renderObject.VAO);
+    glUseProgram(renderObject.shaderProgram);
+    glUniform1f(
+        glGetUniformLocation(renderObject.shaderProgram, "rotateDegOffset"),
+        rotateDegOffset
+    );
+    glUniformMatrix4fv(
+        glGetUniformLocation(renderObject.shaderProgram, "projection"),
+        1, GL_FALSE, glm::value_ptr(projection)
+    );
+    glUniform1f(
+        glGetUniformLocation(renderObject.shaderProgram, "pointScale"),
+        pointScale
+    );
+
+    // Borders are a later layer so they stay on top of every fill.
+    const DrawPacket fill{
+        .layer{ 0 },
+        .program{ renderObject.shaderProgram },
+        .VAO{ renderObject.VAO },
+        .primitive{ GL_TRIANGLES },
+        .passLocation{
+            glGetUniformLocation(renderObject.shaderProgram, "pass")
+        },
+        .passValue{ TRIANGLE_INSTANCE_FILL },
+        .first{ 0 },
+        .count{ 3 },
+        .instanceCount{ instanceCount },
+    };
+    auto border{ fill };
+    border.layer = 1;
+    border.passValue = TRIANGLE_INSTANCE_BORDER;
+
+    submitDrawPacket(renderQueue, fill);
+    border.primitive = GL_LINE_LOOP;
+    submitDrawPacket(renderQueue, border);
+    border.primitive = GL_POINTS;
+    submitDrawPacket(renderQueue, border);
+    flushRenderQueue(renderQueue);
+}
 
-        glPointSize(triangle.pointSize);
-        if (triangle.border) {
-            glDrawArrays(GL_POINTS, 0, 3);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
+// Points grow with the poster so it looks like an enlarged screenshot; the
+// tile margin keeps the largest of them from being cut at tile edges.
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+renderTrianglePoster(const Options& options, const GLsizei& windowSize,
+                     const RenderObject& renderObject,
+                     const Triangles& triangles, const float& rotateDegOffset,
+                     RenderQueue& renderQueue) {
+    const auto pointScale{ (float)options.posterSize / windowSize };
+    std::array<GLfloat, 2> pointSizeRange{};
+    glGetFloatv(GL_POINT_SIZE_RANGE, pointSizeRange.data());
+    float maxPointSize{ 0.0f };
+    for (const auto& style : triangles.styles)
+        maxPointSize = std::max(maxPointSize, style.pointSize * pointScale);
+    maxPointSize = std::min(maxPointSize, pointSizeRange[1]);
+
+    const PosterOptions posterOptions{
+        .width{ options.posterSize },
+        .height{ options.posterSize },
+        .tileSize{ 1024 },
+        .margin{ (GLsizei)std::ceil(maxPointSize / 2) },
+    };
+    return renderPoster(
+        options.posterPath.value(), posterOptions,
+        [&](const glm::mat4& projection) {
+            renderGl(renderObject, (GLsizei)triangles.styles.size(),
+                     rotateDegOffset, projection, pointScale, renderQueue);
         }
-
-        if (triangle.fill) glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        glm::mat4 trans{ glm::mat4(1.0f) };
-        const auto rotateDegOffset{ animate ? (float)glfwGetTime() : 0 };
-        trans = glm::rotate(
-            trans,
-            glm::radians(triangle.rotateDeg + rotateDegOffset),
-            glm::vec3(0.0, 0.0, 1.0)
-        );
-        trans = glm::scale(trans, glm::vec3(
-            triangle.scale, triangle.scale, triangle.scale
-        ));
-        glUniformMatrix4fv(
-            glGetUniformLocation(triangle.renderObject.shaderProgram, "trans"),
-            1, GL_FALSE, glm::value_ptr(trans)
-        );
-
-        glUniform4f(
-            glGetUniformLocation(triangle.renderObject.shaderProgram, "color"),
-            triangle.color.at(0), triangle.color.at(1),
-            triangle.color.at(2), triangle.color.at(3)
-        );
-    }
+    );
 }
 
-void renderGui(const std::span<Triangle>& triangles, bool& animate) {
+TriangleEdit renderGui(Triangles& triangles, TriangleSelection& selection,
+                       TriangleFilter& filter, const PickIndex& pickIndex,
+                       const float& rotateDegOffset, bool& animate,
+                       FrameProfiler& profiler,
+                       const RenderQueueStats& renderStats) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -176,33 +700,266 @@ void renderGui(const std::span<Triangle>& triangles, bool& animate) {
     ImGui::Text("Let there be OpenGL!");
     ImGui::Checkbox("Animation", &animate);
 
-    static size_t selectedIdx{ 0 };
-    const auto comboPreview{ std::to_string(selectedIdx) };
-    if (ImGui::BeginCombo("Triangle Selection", comboPreview.c_str())) {
-        for (size_t idx{ 0 }; const auto & triangle : triangles) {
-            const bool isSelected{ selectedIdx == idx };
-            if (ImGui::Selectable(std::to_string(idx).c_str(), isSelected)) {
-                selectedIdx = idx;
-            }
-            if (isSelected) ImGui::SetItemDefaultFocus();
-
-            ++idx;
+    static double pickMs{ 0.0 };
+    const auto& io{ ImGui::GetIO() };
+    if (!io.WantCaptureMouse && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+        // The triangles are drawn straight in normalized device coordinates.
+        const glm::vec2 point{
+            2.0f * io.MousePos.x / io.DisplaySize.x - 1.0f,
+            1.0f - 2.0f * io.MousePos.y / io.DisplaySize.y
+        };
+        const auto start{ std::chrono::steady_clock::now() };
+        const auto picked{ pickTriangle(pickIndex, point, rotateDegOffset) };
+        pickMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        if (picked.has_value()) {
+            if (io.KeyCtrl) toggleSelected(selection, picked.value());
+            else selectOnly(selection, picked.value());
         }
-        ImGui::EndCombo();
     }
+    ImGui::Text("Click a triangle to select it (%.3f ms)", pickMs);
 
-    ImGui::Checkbox("Border", &triangles[selectedIdx].border);
-    ImGui::Checkbox("Fill", &triangles[selectedIdx].fill);
-    ImGui::SliderFloat("Point Size", &triangles[selectedIdx].pointSize,
-                       5.0f, 20.0f);
-    ImGui::SliderFloat("Scale", &triangles[selectedIdx].scale, 0.0f, 4.0f);
-    ImGui::SliderFloat("Rotate", &triangles[selectedIdx].rotateDeg, 0.0f, 360.0f);
-    ImGui::ColorEdit4("Color", triangles[selectedIdx].color.data());
+    renderTriangleList(triangles, selection, filter, pickIndex);
+    auto edit{ renderTriangleEditor(triangles, selection) };
+    edit.finished = !ImGui::IsAnyItemActive();
+
+    renderProfilerGui(profiler);
+    ImGui::Text("Draw calls: %zu (%zu packets)", renderStats.drawCalls,
+                renderStats.packets);
+    ImGui::Text("State changes: %zu (%zu avoided)", renderStats.stateChanges,
+                renderStats.stateChangesAvoided);
     ImGui::End();
 
 
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    return edit;
+}
+
+void selectOnly(TriangleSelection& selection, const uint32_t& idx) {
+    for (const auto& selected : selection.indices)
+        selection.positions[selected] = 0;
+    selection.indices.assign(1, idx);
+    selection.positions[idx] = 1;
+}
+
+// Deselecting fills the gap from the end in O(1). The last triangle is the one
+// shown in the editor, so it stays last unless it is the one deselected.
+void toggleSelected(TriangleSelection& selection, const uint32_t& idx) {
+    auto& indices{ selection.indices };
+    auto& positions{ selection.positions };
+    if (positions[idx] == 0) {
+        indices.push_back(idx);
+        positions[idx] = (uint32_t)indices.size();
+        return;
+    }
+
+    const auto place{ [&](const size_t& position, const uint32_t& moved) {
+        indices[position] = moved;
+        positions[moved] = (uint32_t)position + 1;
+    } };
+    const size_t position{ positions[idx] - 1 };
+    const auto last{ indices.size() - 1 };
+    if (position < last) {
+        if (position + 1 < last) place(position, indices[last - 1]);
+        place(last - 1, indices[last]);
+    }
+    indices.pop_back();
+    positions[idx] = 0;
+}
+
+bool isFilterActive(const TriangleFilter& filter) {
+    return filter.byColor || filter.minScale > 0.0f ||
+        filter.maxScale < maxTriangleScale;
+}
+
+// Walks the scale-sorted pick index instead of every triangle, and collects
+// the matches into a bitmap so they come out in ascending order unsorted.
+void updateTriangleFilter(TriangleFilter& filter, const Triangles& triangles,
+                          const PickIndex& pickIndex) {
+    if (!filter.dirty) return;
+    filter.dirty = false;
+    filter.matches.clear();
+    if (!isFilterActive(filter)) return;
+
+    filter.matchBits.assign((triangles.styles.size() + 63) / 64, 0);
+    const auto candidates{
+        trianglesInScaleRange(pickIndex, filter.minScale, filter.maxScale)
+    };
+    for (const auto& idx : candidates) {
+        if (filter.byColor) {
+            const auto& color{ triangles.styles[idx].color };
+            float difference{ 0.0f };
+            for (size_t channel{ 0 }; channel < 3; ++channel) {
+                difference = std::max(
+                    difference, std::abs(color[channel] - filter.color[channel])
+                );
+            }
+            if (difference > filter.colorTolerance) continue;
+        }
+        filter.matchBits[idx / 64] |= uint64_t{ 1 } << (idx % 64);
+    }
+
+    for (size_t word{ 0 }; word < filter.matchBits.size(); ++word) {
+        for (auto bits{ filter.matchBits[word] }; bits != 0; bits &= bits - 1)
+            filter.matches.push_back(
+                (uint32_t)(word * 64 + std::countr_zero(bits))
+            );
+    }
+}
+
+// Only the rows scrolled into view are formatted, so the cost does not grow
+// with the number of triangles.
+void renderTriangleList(const Triangles& triangles,
+                        TriangleSelection& selection, TriangleFilter& filter,
+                        const PickIndex& pickIndex) {
+    filter.dirty |= ImGui::DragFloatRange2(
+        "Scale Range", &filter.minScale, &filter.maxScale, 0.01f, 0.0f,
+        maxTriangleScale
+    );
+    filter.dirty |= ImGui::Checkbox("Filter by Color", &filter.byColor);
+    if (filter.byColor) {
+        filter.dirty |= ImGui::ColorEdit3("Filter Color", filter.color.data());
+        filter.dirty |= ImGui::SliderFloat("Color Tolerance",
+                                           &filter.colorTolerance, 0.0f, 1.0f);
+    }
+    updateTriangleFilter(filter, triangles, pickIndex);
+
+    const auto active{ isFilterActive(filter) };
+    const auto rowCount{
+        active ? filter.matches.size() : triangles.styles.size()
+    };
+    const auto rowTriangle{ [&](const size_t& row) {
+        return active ? filter.matches[row] : (uint32_t)row;
+    } };
+
+    if (ImGui::Button("Select All") && rowCount > 0) {
+        selectOnly(selection, rowTriangle(0));
+        for (size_t row{ 1 }; row < rowCount; ++row)
+            toggleSelected(selection, rowTriangle(row));
+    }
+    ImGui::SameLine();
+    ImGui::Text("%zu of %zu triangles, %zu selected", rowCount,
+                triangles.styles.size(), selection.indices.size());
+
+    const auto flags{
+        ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg |
+        ImGuiTableFlags_BordersOuter
+    };
+    if (!ImGui::BeginTable("Triangles", 4, flags, ImVec2{ 0.0f, 200.0f }))
+        return;
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Index");
+    ImGui::TableSetupColumn("Scale");
+    ImGui::TableSetupColumn("Rotate");
+    ImGui::TableSetupColumn("Color");
+    ImGui::TableHeadersRow();
+
+    ImGuiListClipper clipper{};
+    clipper.Begin((int)rowCount);
+    while (clipper.Step()) {
+        for (auto row{ clipper.DisplayStart }; row < clipper.DisplayEnd;
+             ++row) {
+            const auto idx{ rowTriangle(row) };
+            ImGui::PushID((int)idx);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable("##row", selection.positions[idx] != 0,
+                                  ImGuiSelectableFlags_SpanAllColumns)) {
+                const auto& io{ ImGui::GetIO() };
+                if (io.KeyShift) {
+                    // The anchor may be past the end after refiltering.
+                    const auto anchor{
+                        std::min(selection.anchorRow, rowCount - 1)
+                    };
+                    const auto first{ std::min<size_t>(anchor, row) };
+                    const auto last{ std::max<size_t>(anchor, row) };
+                    selectOnly(selection, rowTriangle(first));
+                    for (auto other{ first + 1 }; other <= last; ++other)
+                        toggleSelected(selection, rowTriangle(other));
+                } else {
+                    if (io.KeyCtrl) toggleSelected(selection, idx);
+                    else selectOnly(selection, idx);
+                    selection.anchorRow = row;
+                }
+            }
+            ImGui::SameLine();
+            ImGui::Text("%u", idx);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", triangles.scales[idx]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", triangles.rotateDegs[idx]);
+            ImGui::TableNextColumn();
+            const auto& color{ triangles.styles[idx].color };
+            ImGui::ColorButton(
+                "##color", ImVec4{ color[0], color[1], color[2], color[3] },
+                ImGuiColorEditFlags_NoTooltip,
+                ImVec2{ ImGui::GetTextLineHeight() * 2,
+                        ImGui::GetTextLineHeight() }
+            );
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndTable();
+}
+
+// Shows the last selected triangle; a changed field is copied to the whole
+// selection.
+TriangleEdit renderTriangleEditor(Triangles& triangles,
+                                  const TriangleSelection& selection) {
+    if (selection.indices.empty()) {
+        ImGui::Text("No triangle selected");
+        return TriangleEdit{};
+    }
+
+    const auto primary{ selection.indices.back() };
+    auto& style{ triangles.styles[primary] };
+    TriangleEdit edit{};
+    const auto applyToSelection{
+        [&](const bool& pickIndex, const bool& filter, const auto& apply) {
+            for (const auto& idx : selection.indices) apply(idx);
+            edit.instances = true;
+            edit.pickIndex |= pickIndex;
+            edit.filter |= filter;
+        }
+    };
+
+    // Border and fill decide whether a triangle can be picked.
+    if (ImGui::Checkbox("Border", &style.border)) {
+        applyToSelection(true, false, [&](const auto& idx) {
+            triangles.styles[idx].border = style.border;
+        });
+    }
+    if (ImGui::Checkbox("Fill", &style.fill)) {
+        applyToSelection(true, false, [&](const auto& idx) {
+            triangles.styles[idx].fill = style.fill;
+        });
+    }
+    if (ImGui::SliderFloat("Point Size", &style.pointSize, 5.0f, 20.0f)) {
+        applyToSelection(false, false, [&](const auto& idx) {
+            triangles.styles[idx].pointSize = style.pointSize;
+        });
+    }
+    if (ImGui::SliderFloat("Scale", &triangles.scales[primary], 0.0f,
+                           maxTriangleScale)) {
+        applyToSelection(true, true, [&](const auto& idx) {
+            triangles.scales[idx] = triangles.scales[primary];
+        });
+    }
+    if (ImGui::SliderFloat("Rotate", &triangles.rotateDegs[primary], 0.0f,
+                           360.0f)) {
+        applyToSelection(true, false, [&](const auto& idx) {
+            triangles.rotateDegs[idx] = triangles.rotateDegs[primary];
+        });
+    }
+    if (ImGui::ColorEdit4("Color", style.color.data())) {
+        applyToSelection(false, true, [&](const auto& idx) {
+            triangles.styles[idx].color = style.color;
+        });
+    }
+    return edit;
 }
 
 // Quit when ESC is released
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#define LAB1_HAS_SSE
+#include <immintrin.h>
+#endif
+
+#include "picking.h"
+
+// Farthest vertex of the unit triangle from the origin.
+constexpr float unitTriangleCircumradius{ 0.70710678f };
+
+int64_t pickCandidates(const PickIndex& pickIndex, size_t begin,
+                       const float& x, const float& y);
+
+void buildPickIndex(PickIndex& pickIndex,
+                    const std::span<const float>& scales,
+                    const std::span<const float>& rotateDegs,
+                    const std::span<const uint8_t>& pickable) {
+    std::vector<uint32_t> order(scales.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](const auto& a, const auto& b) {
+                         return scales[a] < scales[b];
+                     });
+
+    pickIndex.scales.resize(order.size());
+    pickIndex.cosRotates.resize(order.size());
+    pickIndex.sinRotates.resize(order.size());
+    pickIndex.pickable.resize(order.size());
+    pickIndex.positions.resize(order.size());
+    for (uint32_t position{ 0 }; position < order.size(); ++position) {
+        const auto idx{ order[position] };
+        const auto angle{ glm::radians(rotateDegs[idx]) };
+        pickIndex.scales[position] = scales[idx];
+        pickIndex.cosRotates[position] = std::cos(angle);
+        pickIndex.sinRotates[position] = std::sin(angle);
+        pickIndex.pickable[position] = pickable[idx];
+        pickIndex.positions[idx] = position;
+    }
+    pickIndex.triangleIndices = std::move(order);
+}
+
+void updatePickIndex(PickIndex& pickIndex,
+                     const uint32_t& triangleIdx,
+                     const float& scale,
+                     const float& rotateDeg,
+                     const bool& pickable) {
+    auto& scales{ pickIndex.scales };
+    const size_t from{ pickIndex.positions[triangleIdx] };
+    const auto to{ (size_t)(
+        scale < scales[from]
+            ? std::upper_bound(scales.begin(), scales.begin() + from, scale) -
+                scales.begin()
+            : std::lower_bound(scales.begin() + from + 1, scales.end(),
+                               scale) - scales.begin() - 1
+    ) };
+
+    // Shift everything between the old and the new position by one.
+    const auto move{ [&](auto& values) {
+        if (to < from) {
+            std::rotate(values.begin() + to, values.begin() + from,
+                        values.begin() + from + 1);
+        } else {
+            std::rotate(values.begin() + from, values.begin() + from + 1,
+                        values.begin() + to + 1);
+        }
+    } };
+    move(scales);
+    move(pickIndex.cosRotates);
+    move(pickIndex.sinRotates);
+    move(pickIndex.triangleIndices);
+    move(pickIndex.pickable);
+    for (auto position{ std::min(from, to) }; position <= std::max(from, to);
+         ++position) {
+        pickIndex.positions[pickIndex.triangleIndices[position]] =
+            (uint32_t)position;
+    }
+
+    const auto angle{ glm::radians(rotateDeg) };
+    scales[to] = scale;
+    pickIndex.cosRotates[to] = std::cos(angle);
+    pickIndex.sinRotates[to] = std::sin(angle);
+    pickIndex.pickable[to] = pickable;
+}
+
+std::span<const uint32_t> trianglesInScaleRange(const PickIndex& pickIndex,
+                                                const float& minScale,
+                                                const float& maxScale) {
+    const auto& scales{ pickIndex.scales };
+    const auto begin{
+        std::lower_bound(scales.begin(), scales.end(), minScale) -
+            scales.begin()
+    };
+    const auto end{
+        std::upper_bound(scales.begin() + begin, scales.end(), maxScale) -
+            scales.begin()
+    };
+    return std::span<const uint32_t>(pickIndex.triangleIndices)
+        .subspan(begin, end - begin);
+}
+
+const std::optional<uint32_t> pickTriangle(const PickIndex& pickIndex,
+                                           const glm::vec2& point,
+                                           const float& rotateDegOffset) {
+    // Undo the rotation shared by all triangles first.
+    const auto offset{ glm::radians(rotateDegOffset) };
+    const auto x{ std::cos(offset) * point.x + std::sin(offset) * point.y };
+    const auto y{ -std::sin(offset) * point.x + std::cos(offset) * point.y };
+
+    const auto minScale{ std::hypot(x, y) / unitTriangleCircumradius };
+    const auto begin{
+        std::lower_bound(pickIndex.scales.begin(), pickIndex.scales.end(),
+                         std::max(minScale, 0.0f)) - pickIndex.scales.begin()
+    };
+
+    const auto picked{ pickCandidates(pickIndex, begin, x, y) };
+    if (picked < 0) return std::nullopt;
+    return (uint32_t)picked;
+}
+
+// Rotating the point by -rotateDeg brings it into the frame of the triangle,
+// scaled by s: (-s/2, -s/2), (s/2, -s/2), (0, s/2). It is inside when
+//   y >= -s/2,  2x + y <= s/2  and  -2x + y <= s/2.
+int64_t pickCandidates(const PickIndex& pickIndex, size_t begin,
+                       const float& x, const float& y) {
+    const auto end{ pickIndex.scales.size() };
+    const auto scales{ pickIndex.scales.data() };
+    const auto cosRotates{ pickIndex.cosRotates.data() };
+    const auto sinRotates{ pickIndex.sinRotates.data() };
+    int64_t picked{ -1 };
+    const auto collect{ [&](const size_t& base, unsigned mask) {
+        while (mask != 0) {
+            const auto position{ base + std::countr_zero(mask) };
+            if (pickIndex.pickable[position]) {
+                picked = std::max<int64_t>(
+                    picked, pickIndex.triangleIndices[position]
+                );
+            }
+            mask &= mask - 1;
+        }
+    } };
+
+#ifdef __AVX2__
+    {
+        const auto x8{ _mm256_set1_ps(x) };
+        const auto y8{ _mm256_set1_ps(y) };
+        const auto half{ _mm256_set1_ps(0.5f) };
+        for (; begin + 8 <= end; begin += 8) {
+            const auto c{ _mm256_loadu_ps(cosRotates + begin) };
+            const auto s{ _mm256_loadu_ps(sinRotates + begin) };
+            const auto halfScale{
+                _mm256_mul_ps(half, _mm256_loadu_ps(scales + begin))
+            };
+            const auto localX{
+                _mm256_add_ps(_mm256_mul_ps(c, x8), _mm256_mul_ps(s, y8))
+            };
+            const auto localY{
+                _mm256_sub_ps(_mm256_mul_ps(c, y8), _mm256_mul_ps(s, x8))
+            };
+            const auto twoX{ _mm256_add_ps(localX, localX) };
+            const auto inside{ _mm256_and_ps(
+                _mm256_cmp_ps(
+                    localY, _mm256_sub_ps(_mm256_setzero_ps(), halfScale),
+                    _CMP_GE_OQ
+                ),
+                _mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_add_ps(twoX, localY), halfScale,
+                                  _CMP_LE_OQ),
+                    _mm256_cmp_ps(_mm256_sub_ps(localY, twoX), halfScale,
+                                  _CMP_LE_OQ)
+                )
+            ) };
+            collect(begin, (unsigned)_mm256_movemask_ps(inside));
+        }
+    }
+#endif
+#ifdef LAB1_HAS_SSE
+    {
+        const auto x4{ _mm_set1_ps(x) };
+        const auto y4{ _mm_set1_ps(y) };
+        const auto half{ _mm_set1_ps(0.5f) };
+        for (; begin + 4 <= end; begin += 4) {
+            const auto c{ _mm_loadu_ps(cosRotates + begin) };
+            const auto s{ _mm_loadu_ps(sinRotates + begin) };
+            const auto halfScale{
+                _mm_mul_ps(half, _mm_loadu_ps(scales + begin))
+            };
+            const auto localX{
+                _mm_add_ps(_mm_mul_ps(c, x4), _mm_mul_ps(s, y4))
+            };
+            const auto localY{
+                _mm_sub_ps(_mm_mul_ps(c, y4), _mm_mul_ps(s, x4))
+            };
+            const auto twoX{ _mm_add_ps(localX, localX) };
+            const auto inside{ _mm_and_ps(
+                _mm_cmpge_ps(localY, _mm_sub_ps(_mm_setzero_ps(), halfScale)),
+                _mm_and_ps(
+                    _mm_cmple_ps(_mm_add_ps(twoX, localY), halfScale),
+                    _mm_cmple_ps(_mm_sub_ps(localY, twoX), halfScale)
+                )
+            ) };
+            collect(begin, (unsigned)_mm_movemask_ps(inside));
+        }
+    }
+#endif
+    for (; begin < end; ++begin) {
+        const auto localX{ cosRotates[begin] * x + sinRotates[begin] * y };
+        const auto localY{ cosRotates[begin] * y - sinRotates[begin] * x };
+        const auto halfScale{ 0.5f * scales[begin] };
+        if (localY >= -halfScale && 2 * localX + localY <= halfScale &&
+            localY - 2 * localX <= halfScale) collect(begin, 1);
+    }
+    return picked;
+}
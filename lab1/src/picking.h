@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Every triangle is the unit triangle scaled and rotated about the origin, so
+// it can only contain points within its circumradius. Sorting the triangles
+// by scale turns the ones that can reach a point into a contiguous suffix,
+// which is then tested with SIMD. The arrays are parallel, sorted by scale.
+struct PickIndex {
+    std::vector<float> scales;
+    std::vector<float> cosRotates;
+    std::vector<float> sinRotates;
+    std::vector<uint32_t> triangleIndices;
+    std::vector<uint8_t> pickable;
+    // Position of every triangle in the sorted arrays.
+    std::vector<uint32_t> positions;
+};
+
+// Triangles that are not `pickable` stay in the index but are never picked.
+void buildPickIndex(PickIndex& pickIndex,
+                    const std::span<const float>& scales,
+                    const std::span<const float>& rotateDegs,
+                    const std::span<const uint8_t>& pickable);
+
+// Moves one triangle to its new sorted position in O(distance moved).
+void updatePickIndex(PickIndex& pickIndex,
+                     const uint32_t& triangleIdx,
+                     const float& scale,
+                     const float& rotateDeg,
+                     const bool& pickable);
+
+// Returns the highest-index, so topmost, triangle containing `point` when
+// every triangle is additionally rotated by `rotateDegOffset`.
+const std::optional<uint32_t> pickTriangle(const PickIndex& pickIndex,
+                                           const glm::vec2& point,
+                                           const float& rotateDegOffset);
+
+// Indices of the triangles with a scale in [minScale, maxScale], in no
+// particular order.
+std::span<const uint32_t> trianglesInScaleRange(const PickIndex& pickIndex,
+                                                const float& minScale,
+                                                const float& maxScale);
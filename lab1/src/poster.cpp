@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "image.h"
+#include "poster.h"
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+renderPoster(const std::filesystem::path& path,
+             const PosterOptions& options,
+             const PosterSceneRenderer& renderScene) {
+    GLint maxRenderbufferSize{};
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+    std::array<GLint, 2> maxViewportDims{};
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims.data());
+    const auto maxFramebufferSize{
+        std::min({ maxRenderbufferSize, maxViewportDims[0],
+                   maxViewportDims[1] })
+    };
+    const auto margin{ std::min(options.margin, maxFramebufferSize / 4) };
+    const auto tileSize{
+        std::min(options.tileSize, maxFramebufferSize - 2 * margin)
+    };
+    const auto framebufferSize{ tileSize + 2 * margin };
+
+    ImageWriter writer{};
+    const auto startResult{
+        startImageWriter(writer, path, options.width, options.height)
+    };
+    if (std::holds_alternative<ErrorResult>(startResult))
+        return std::get<ErrorResult>(startResult);
+
+    GLint previousFramebuffer{};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    std::array<GLint, 4> previousViewport{};
+    glGetIntegerv(GL_VIEWPORT, previousViewport.data());
+
+    // One framebuffer is reused by every tile.
+    GLuint framebuffer{};
+    GLuint colorRenderbuffer{};
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, framebufferSize,
+                          framebufferSize);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, colorRenderbuffer);
+    const auto complete{
+        glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE
+    };
+
+    const auto cleanup{ [&]() {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1],
+                   previousViewport[2], previousViewport[3]);
+        glDeleteRenderbuffers(1, &colorRenderbuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+    } };
+    if (!complete) {
+        cleanup();
+        return ErrorResult{ "Poster framebuffer is incomplete" };
+    }
+
+    // Rows of the band are read bottom first, straight into their place.
+    std::vector<uint8_t> band((size_t)options.width * tileSize * 3);
+    glViewport(0, 0, framebufferSize, framebufferSize);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, options.width);
+
+    // Bands go from the top of the poster down, in the order they are written.
+    for (GLsizei top{ options.height }; top > 0; top -= tileSize) {
+        const auto bandHeight{ std::min(tileSize, top) };
+        const auto bottom{ top - bandHeight };
+        for (GLsizei left{ 0 }; left < options.width; left += tileSize) {
+            const auto tileWidth{ std::min(tileSize, options.width - left) };
+
+            // The framebuffer covers the tile plus the margin around it.
+            const auto toView{ [](const GLsizei& pixel, const GLsizei& size) {
+                return -1.0f + 2.0f * pixel / size;
+            } };
+            renderScene(glm::ortho(
+                toView(left - margin, options.width),
+                toView(left - margin + framebufferSize, options.width),
+                toView(bottom - margin, options.height),
+                toView(bottom - margin + framebufferSize, options.height)
+            ));
+
+            glReadPixels(margin, margin, tileWidth, bandHeight, GL_RGB,
+                         GL_UNSIGNED_BYTE, band.data() + (size_t)left * 3);
+        }
+
+        const auto rowSize{ (size_t)options.width * 3 };
+        for (GLsizei row{ 0 }; row < bandHeight / 2; ++row) {
+            std::swap_ranges(
+                band.begin() + row * rowSize,
+                band.begin() + (row + 1) * rowSize,
+                band.begin() + (bandHeight - 1 - row) * rowSize
+            );
+        }
+        const auto writeResult{ writeImageRows(
+            writer,
+            std::span<const uint8_t>(band).first(bandHeight * rowSize)
+        ) };
+        if (std::holds_alternative<ErrorResult>(writeResult)) {
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            cleanup();
+            return std::get<ErrorResult>(writeResult);
+        }
+    }
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    cleanup();
+    return startResult;
+}
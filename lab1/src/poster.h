@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <variant>
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "result.h"
+
+struct PosterOptions {
+    GLsizei width;
+    GLsizei height;
+    // Largest tile edge; clamped to what the driver supports.
+    GLsizei tileSize;
+    // Extra pixels rendered around every tile and cropped afterwards, so
+    // primitives clipped by their center, such as points, do not show seams.
+    GLsizei margin;
+};
+
+// Draws the scene seen through `projection` into the bound framebuffer.
+using PosterSceneRenderer = std::function<void(const glm::mat4& projection)>;
+
+// Renders a poster larger than any framebuffer tile by tile, where every tile
+// narrows the projection to its part of the [-1, 1] view. Tiles are written
+// as soon as their row is complete, so only one row of tiles is ever held.
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+renderPoster(const std::filesystem::path& path,
+             const PosterOptions& options,
+             const PosterSceneRenderer& renderScene);
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "imgui.h"
+
+#include "profiler.h"
+
+constexpr std::array<const char*, PROFILER_STAGE_COUNT> profilerStageNames{
+    "renderGl",
+    "renderGui",
+};
+
+void resolveProfilerSample(FrameProfiler& profiler, const size_t& slot);
+void writeProfilerCsvSample(FrameProfiler& profiler,
+                            const ProfilerSample& sample);
+
+ProfilerScope::ProfilerScope(FrameProfiler& profiler,
+                             const ProfilerStage& stage)
+    : profiler{ profiler }, stage{ stage },
+      start{ std::chrono::steady_clock::now() } {
+    const auto slot{ profiler.frame % FrameProfiler::latency };
+    glQueryCounter(profiler.queries[slot][2 * stage], GL_TIMESTAMP);
+}
+
+ProfilerScope::~ProfilerScope() {
+    const auto slot{ profiler.frame % FrameProfiler::latency };
+    glQueryCounter(profiler.queries[slot][2 * stage + 1], GL_TIMESTAMP);
+    profiler.issued[slot][stage] = true;
+
+    const std::chrono::duration<double, std::milli> elapsed{
+        std::chrono::steady_clock::now() - start
+    };
+    profiler.pending[slot].cpuMs[stage] = elapsed.count();
+}
+
+void initProfiler(FrameProfiler& profiler) {
+    // Nothing has been measured yet.
+    for (auto& history : profiler.gpuHistory)
+        history.fill(std::numeric_limits<float>::quiet_NaN());
+    for (auto& slotQueries : profiler.queries)
+        glGenQueries((GLsizei)slotQueries.size(), slotQueries.data());
+}
+
+void cleanupProfiler(FrameProfiler& profiler) {
+    stopProfilerCsv(profiler);
+    for (auto& slotQueries : profiler.queries)
+        glDeleteQueries((GLsizei)slotQueries.size(), slotQueries.data());
+}
+
+void beginProfilerFrame(FrameProfiler& profiler) {
+    const auto slot{ profiler.frame % FrameProfiler::latency };
+    if (profiler.frame >= FrameProfiler::latency)
+        resolveProfilerSample(profiler, slot);
+
+    profiler.pending[slot] = ProfilerSample{ .frame{ profiler.frame } };
+    profiler.issued[slot].fill(false);
+}
+
+void endProfilerFrame(FrameProfiler& profiler) {
+    ++profiler.frame;
+}
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startProfilerCsv(FrameProfiler& profiler, const std::filesystem::path& path) {
+    stopProfilerCsv(profiler);
+    profiler.csv.open(path, std::ios::trunc);
+    if (!profiler.csv.is_open()) return ErrorResult{
+        "Fail to open file: " + path.string()
+    };
+
+    profiler.csv << "frame";
+    for (const auto& name : profilerStageNames)
+        profiler.csv << "," << name << "_cpu_ms," << name << "_gpu_ms";
+    profiler.csv << "\n";
+    return SuccessResult<const std::filesystem::path>{
+        std::filesystem::absolute(path)
+    };
+}
+
+void stopProfilerCsv(FrameProfiler& profiler) {
+    if (profiler.csv.is_open()) profiler.csv.close();
+}
+
+void renderProfilerGui(FrameProfiler& profiler) {
+    if (!ImGui::CollapsingHeader("Profiler")) return;
+
+    for (size_t stage{ 0 }; stage < PROFILER_STAGE_COUNT; ++stage) {
+        const auto& cpuHistory{ profiler.cpuHistory[stage] };
+        const auto& gpuHistory{ profiler.gpuHistory[stage] };
+        // Missing samples are NaN; they are left out of the average and the
+        // maximum, and drawn as empty bars.
+        const auto overlay{ [](const char* label, const auto& history) {
+            float sum{ 0.0f };
+            size_t count{ 0 };
+            for (const auto& value : history) {
+                if (std::isnan(value)) continue;
+                sum += value;
+                ++count;
+            }
+            if (count == 0) return std::string{ label } + " n/a";
+            return std::string{ label } + " " + std::to_string(sum / count) +
+                " ms";
+        } };
+        const auto maximum{ [](const auto& history) {
+            float result{ 1.0f };
+            for (const auto& value : history)
+                if (!std::isnan(value)) result = std::max(result, value);
+            return result;
+        } };
+        const auto measured{ [](void* data, int idx) {
+            const auto value{ ((const float*)data)[idx] };
+            return std::isnan(value) ? 0.0f : value;
+        } };
+
+        const auto cpuOverlay{ overlay("CPU", cpuHistory) };
+        const auto gpuOverlay{ overlay("GPU", gpuHistory) };
+        ImGui::Text("%s", profilerStageNames[stage]);
+        ImGui::PushID((int)stage);
+        ImGui::PlotHistogram(
+            "##cpu", cpuHistory.data(), (int)cpuHistory.size(),
+            (int)profiler.historyOffset, cpuOverlay.c_str(), 0.0f,
+            maximum(cpuHistory), ImVec2(0, 40)
+        );
+        ImGui::PlotHistogram(
+            "##gpu", measured, (void*)gpuHistory.data(),
+            (int)gpuHistory.size(), (int)profiler.historyOffset,
+            gpuOverlay.c_str(), 0.0f, maximum(gpuHistory), ImVec2(0, 40)
+        );
+        ImGui::PopID();
+    }
+
+    static std::string csvStatus{};
+    bool recording{ profiler.csv.is_open() };
+    if (ImGui::Checkbox("Record CSV", &recording)) {
+        if (recording) {
+            const auto startResult{ startProfilerCsv(profiler, "profile.csv") };
+            if (std::holds_alternative<ErrorResult>(startResult)) {
+                csvStatus = std::get<ErrorResult>(startResult).message;
+            } else {
+                csvStatus = "Recording to " + std::get<
+                    SuccessResult<const std::filesystem::path>
+                >(startResult).value.string();
+            }
+        } else {
+            stopProfilerCsv(profiler);
+        }
+    }
+    if (!csvStatus.empty()) ImGui::TextWrapped("%s", csvStatus.c_str());
+}
+
+// Only called `latency` frames after the slot was filled; a query that is
+// still not available is dropped instead of waited on, leaving the GPU time
+// NaN.
+void resolveProfilerSample(FrameProfiler& profiler, const size_t& slot) {
+    auto& sample{ profiler.pending[slot] };
+    for (size_t stage{ 0 }; stage < PROFILER_STAGE_COUNT; ++stage) {
+        sample.gpuMs[stage] = std::numeric_limits<double>::quiet_NaN();
+        if (!profiler.issued[slot][stage]) continue;
+
+        const auto beginQuery{ profiler.queries[slot][2 * stage] };
+        const auto endQuery{ profiler.queries[slot][2 * stage + 1] };
+        GLint available{ GL_FALSE };
+        glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE) continue;
+
+        GLuint64 begin{}, end{};
+        glGetQueryObjectui64v(beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &end);
+        sample.gpuMs[stage] = (end - begin) / 1e6;
+    }
+
+    for (size_t stage{ 0 }; stage < PROFILER_STAGE_COUNT; ++stage) {
+        profiler.cpuHistory[stage][profiler.historyOffset] =
+            (float)sample.cpuMs[stage];
+        profiler.gpuHistory[stage][profiler.historyOffset] =
+            (float)sample.gpuMs[stage];
+    }
+    profiler.historyOffset =
+        (profiler.historyOffset + 1) % FrameProfiler::historySize;
+
+    if (profiler.csv.is_open()) writeProfilerCsvSample(profiler, sample);
+}
+
+void writeProfilerCsvSample(FrameProfiler& profiler,
+                            const ProfilerSample& sample) {
+    profiler.csv << sample.frame;
+    // A missing GPU time is an empty field.
+    for (size_t stage{ 0 }; stage < PROFILER_STAGE_COUNT; ++stage) {
+        profiler.csv << "," << sample.cpuMs[stage] << ",";
+        if (!std::isnan(sample.gpuMs[stage]))
+            profiler.csv << sample.gpuMs[stage];
+    }
+    profiler.csv << "\n";
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <variant>
+
+#include "glad/glad.h"
+
+#include "result.h"
+
+enum ProfilerStage {
+    PROFILER_STAGE_GL,
+    PROFILER_STAGE_GUI,
+    PROFILER_STAGE_COUNT,
+};
+
+struct ProfilerSample {
+    uint64_t frame;
+    std::array<double, PROFILER_STAGE_COUNT> cpuMs;
+    // NaN when the GPU time was not measured or not available in time.
+    std::array<double, PROFILER_STAGE_COUNT> gpuMs;
+};
+
+// Times each stage on the CPU and, with GL_TIMESTAMP queries, on the GPU.
+// Queries are kept in a ring and read back `latency` frames after they were
+// issued, so reading them never stalls the pipeline.
+struct FrameProfiler {
+    static constexpr size_t latency{ 4 };
+    static constexpr size_t historySize{ 240 };
+
+    uint64_t frame;
+    // Begin and end timestamp query of every stage, per in-flight frame.
+    std::array<std::array<GLuint, 2 * PROFILER_STAGE_COUNT>, latency> queries;
+    std::array<std::array<bool, PROFILER_STAGE_COUNT>, latency> issued;
+    std::array<ProfilerSample, latency> pending;
+
+    std::array<std::array<float, historySize>, PROFILER_STAGE_COUNT> cpuHistory;
+    std::array<std::array<float, historySize>, PROFILER_STAGE_COUNT> gpuHistory;
+    size_t historyOffset;
+
+    std::ofstream csv;
+};
+
+// Times the enclosing block as `stage` of the current frame.
+struct ProfilerScope {
+    ProfilerScope(FrameProfiler& profiler, const ProfilerStage& stage);
+    ~ProfilerScope();
+
+    FrameProfiler& profiler;
+    const ProfilerStage stage;
+    const std::chrono::steady_clock::time_point start;
+};
+
+void initProfiler(FrameProfiler& profiler);
+
+void cleanupProfiler(FrameProfiler& profiler);
+
+void beginProfilerFrame(FrameProfiler& profiler);
+
+void endProfilerFrame(FrameProfiler& profiler);
+
+const std::variant<SuccessResult<const std::filesystem::path>, ErrorResult>
+startProfilerCsv(FrameProfiler& profiler, const std::filesystem::path& path);
+
+void stopProfilerCsv(FrameProfiler& profiler);
+
+// Draws the profiler widgets into the current ImGui window.
+void renderProfilerGui(FrameProfiler& profiler);
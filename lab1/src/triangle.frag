@@ -1,6 +1,6 @@
 #version 330 core
+in vec4 vColor;
 out vec4 col;
-uniform vec4 color;
 void main() {
-  col = color;
+  col = vColor;
 }
\ No newline at end of file
@@ -1,8 +1,31 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in float iScale;
+layout (location = 2) in float iRotateDeg;
+layout (location = 3) in float iPointSize;
+layout (location = 4) in uint iFlags;
+layout (location = 5) in vec4 iColor;
 
-uniform mat4 trans;
+uniform float rotateDegOffset;
+uniform uint pass;
+// Identity on screen; selects one tile when rendering a poster.
+uniform mat4 projection;
+uniform float pointScale;
+
+out vec4 vColor;
 
 void main() {
-  gl_Position = trans * vec4(aPos, 1.0f);
+  vColor = iColor;
+  gl_PointSize = iPointSize * pointScale;
+
+  // Instances not drawn in this pass collapse outside the clip volume.
+  if ((iFlags & pass) == 0u) {
+    gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+    return;
+  }
+
+  float angle = radians(iRotateDeg + rotateDegOffset);
+  mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+  gl_Position = projection *
+    vec4(rotation * (iScale * aPos.xy), iScale * aPos.z, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mesh.h"
+
+//One block of an export file for the gzip stage. It is deflated on its own,
+//with the end of the data before it as history, so blocks are compressed in
+//parallel and only written in order.
+struct GzipBlock {
+    std::vector<char> data;
+    std::vector<uint8_t> window; //the data before the block, as far back as deflate refers
+    bool last = false; //the empty block that ends the stream
+    bool deflated = false;
+    std::vector<uint8_t> out;
+};
+
+//Compresses the blocks written to an export file on worker threads, so
+//compression overlaps formatting and uses every core. A writer thread appends
+//the deflated blocks in order. At most a few blocks per worker wait at a time.
+struct GzipStage {
+    std::vector<std::thread> workers;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::shared_ptr<GzipBlock>> blocks; //submitted, not yet written
+    size_t taken = 0; //blocks at the front of the queue a worker has started
+    size_t maxBlocks = 0;
+    bool closed = false; //the last block is submitted
+    std::vector<uint8_t> window; //end of the data submitted so far, only used by the exporter
+    uint32_t crc = 0; //of everything compressed, for the gzip trailer
+    uint32_t size = 0; //modulo 2^32, as gzip stores it
+};
+
+//Where an exporter writes. A name ending in ".gz" is written as gzip,
+//anything else as is.
+struct ExportFile {
+    std::ofstream file;
+    std::vector<char> block; //being filled for the gzip stage
+    std::unique_ptr<GzipStage> gzip;
+};
+
+//False, and progress marked failed, when the file cannot be created. A text
+//file is opened in text mode unless it is compressed, so its line endings are
+//the platform's.
+bool openExportFile(ExportFile& file, const std::string& filename, ExportProgress* progress, const bool text = false);
+
+void writeExportFile(ExportFile& file, const char* data, size_t size);
+inline void writeExportFile(ExportFile& file, std::string_view text) { writeExportFile(file, text.data(), text.size()); }
+
+//Flushes and closes the file. It is removed if the export was cancelled or a
+//write failed, and false is returned; progress is marked failed on a write
+//failure.
+bool finishExportFile(ExportFile& file, const std::string& filename, ExportProgress* progress);
+
+//Writes gzip files of varied data and checks that an independent inflater
+//restores them byte for byte. Prints the result; false on a mismatch.
+bool checkGzipRoundTrip();
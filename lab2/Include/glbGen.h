@@ -0,0 +1,10 @@
+#pragma once
+
+
+#include "mesh.h"
+#include <string>
+
+//progress, if given, is updated as the file is written and can cancel it,
+//in which case the partial file is removed. A mesh without triangles is not
+//written and marks progress failed.
+void SaveGLB(const Mesh& mesh, std::string filename, ExportProgress* progress = nullptr);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+
+//Triangle mesh with shared vertices, laid out the way OpenGL takes it:
+//xyz triplets of positions and three indices per triangle. It is generated,
+//uploaded and exported from the same arrays. Every exporter writes positions
+//in this x y z order, so all formats share the axes and triangle winding.
+struct Mesh {
+    std::vector<GLfloat> positions;
+    std::vector<GLuint> indices;
+};
+
+inline size_t meshVertexCount(const Mesh& mesh) { return mesh.positions.size() / 3; }
+inline size_t meshTriangleCount(const Mesh& mesh) { return mesh.indices.size() / 3; }
+
+//Shared between an exporter and the thread watching it. The exporters count
+//the welded vertices, then the vertices and faces they write, against total.
+//STL is not welded and only counts its triangles.
+struct ExportProgress {
+    std::atomic<size_t> done = 0;
+    std::atomic<size_t> total = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<bool> cancelled = false; //set by the watcher, the exporter stops soon after
+    std::atomic<bool> failed = false; //the file could not be written and was removed
+};
+
+//Merges vertices at exactly the same position, such as the rings shared by
+//neighboring segments and the collapsed rings on the axis, and drops the
+//triangles that become degenerate. Used by the exporters with shared vertices.
+Mesh weldMesh(const Mesh& mesh, ExportProgress* progress = nullptr);
+
+//number of edges not shared by exactly two triangles, none on a closed surface
+size_t openEdgeCount(const Mesh& mesh);
+
+//Welds the mesh for an exporter and sets up progress; nothing when cancelled.
+const std::optional<Mesh> startExport(const Mesh& mesh, ExportProgress* progress);
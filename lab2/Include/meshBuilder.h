@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ruledMesh.h"
+
+//Builds the ruled surface on a worker thread. A new request supersedes the
+//one being built, which is abandoned at the next batch of segments.
+//When a request is expensive, coarse previews at a few low step counts are
+//published first, each as soon as it is done, then refined to the requested
+//tessellation. The geometries are triple buffered: the render thread reads the front
+//one, the worker writes another, and finished meshes are swapped in by
+//takeMesh(). Previews go to a different buffer than the final mesh, so the
+//final one keeps its segments for the next incremental rebuild.
+struct MeshBuilder {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+
+    //newest request, read by the worker under the mutex
+    std::atomic<uint64_t> requested = 0;
+    Tessellation tessellation;
+    std::vector<glm::vec2> editorVertices;
+
+    std::array<RuledGeometry, 3> geometries;
+    int front = 0;
+    int ready = -1; //geometry holding a finished mesh not taken yet
+};
+
+void startMeshBuilder(MeshBuilder& builder);
+
+void requestMesh(MeshBuilder& builder, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices);
+
+//Swaps in the newest finished mesh, if there is one, and returns it.
+//The returned geometry stays valid until the next call.
+const RuledGeometry* takeMesh(MeshBuilder& builder);
+
+//the mesh last returned by takeMesh()
+inline const RuledGeometry& frontMesh(const MeshBuilder& builder) { return builder.geometries[builder.front]; }
+
+void stopMeshBuilder(MeshBuilder& builder);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "mesh.h"
+
+enum ExportFormat { OBJ_EXPORT, STL_EXPORT, PLY_EXPORT, GLB_EXPORT };
+
+//Saves a mesh on a background thread. The mesh is a snapshot that no later
+//edit changes, and the render thread polls the progress every frame.
+struct MeshExport {
+    std::thread thread;
+    std::atomic<bool> running = false;
+    ExportProgress progress;
+    std::string filename;
+    std::chrono::steady_clock::time_point start;
+    std::string status; //outcome of the last export, for the GUI
+};
+
+//snapshot is called on the export thread, so it may build the mesh there
+void startMeshExport(MeshExport& meshExport, const ExportFormat format, const std::string& filename,
+    const std::function<std::shared_ptr<const Mesh>()>& snapshot);
+
+void cancelMeshExport(MeshExport& meshExport);
+
+//joins a finished export and sets its status; true while one is running
+bool updateMeshExport(MeshExport& meshExport);
+
+//written bytes per second so far
+double meshExportThroughput(const MeshExport& meshExport);
+
+//cancels a running export and waits for it
+void stopMeshExport(MeshExport& meshExport);
@@ -1,9 +1,11 @@
 #pragma once
 
 
-#include "helper.h"
-#include <vector>
+#include "mesh.h"
+#include <string>
 
-void SaveOBJ(std::vector <TriangleC> *v, std::string filename);
+//progress, if given, is updated as the file is written and can cancel it,
+//in which case the partial file is removed
+void SaveOBJ(const Mesh& mesh, std::string filename, ExportProgress* progress = nullptr);
 
 
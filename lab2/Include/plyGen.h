@@ -2,10 +2,12 @@
 #define __plygen_h__
 
 
-#include "helper.h"
-#include <vector>
+#include "mesh.h"
+#include <string>
 
-void SavePLY(std::vector <TriangleC> *v, char *filename);
+//progress, if given, is updated as the file is written and can cancel it,
+//in which case the partial file is removed
+void SavePLY(const Mesh& mesh, std::string filename, ExportProgress* progress = nullptr);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "revolution.h"
+
+//Draws the ruled surface straight from the profile, so no mesh is generated
+//for display. Only the profile points are uploaded, to a texture buffer.
+//Either the vertex shader rebuilds every lattice point from gl_VertexID, or a
+//full screen triangle ray marches the distance to the exact surface.
+struct ProceduralSurface {
+    GLuint program = 0;
+    GLuint rayMarchProgram = 0;
+    GLuint VAO = 0; //no attributes, but core profile needs one bound
+    GLuint profileBuffer = 0, profileTexture = 0;
+    GLint modelviewParameter = -1, colorParameter = -1, rowsParameter = -1, stepsParameter = -1, trianglesParameter = -1;
+    GLsizei segmentCount = 0;
+    float boundingRadius = 0; //of the sphere around the origin holding the surface
+};
+
+void initProceduralSurface(ProceduralSurface& surface);
+
+void updateProceduralProfile(ProceduralSurface& surface, const std::vector<glm::vec2>& editorVertices);
+
+//draws the lattice points and the triangles, like the mesh path does
+void drawProceduralSurface(const ProceduralSurface& surface, const Tessellation& tessellation, const glm::mat4& modelView, const float color[4]);
+
+//shades the exact surface of revolution, independent of the tessellation
+void drawRayMarchedSurface(const ProceduralSurface& surface, const glm::mat4& modelView, const float color[4]);
+
+void deleteProceduralSurface(ProceduralSurface& surface);
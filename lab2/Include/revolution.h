@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//radius of the profile segment p1-p2 at height u
+inline GLfloat P(const GLfloat u, const glm::vec2& p1, const glm::vec2& p2) {
+    return (p2[0] - p1[0]) / (p2[1] - p1[1]) * (u - p1[1]) + p1[0];
+}
+
+//point (u, v) of the segment p1-p2 revolved around the y axis
+inline glm::vec3 S(const GLfloat u, const GLfloat v, const glm::vec2& p1, const glm::vec2& p2) {
+    return glm::vec3{ P(u, p1, p2) * sin(2 * M_PI * v), u, P(u, p1, p2) * cos(2 * M_PI * v) };
+}
+
+//sin and cos of 2*pi*v for v = j / steps, j = 0 .. steps - 1
+struct AngularRing {
+    int steps = 0;
+    std::vector<GLfloat> sines;
+    std::vector<GLfloat> cosines;
+};
+
+//the ring only depends on the step count, so it is shared by every segment
+AngularRing createAngularRing(const int step_count);
+
+//P() for count heights at once, with AVX2 or SSE when available
+void profileRadii(const GLfloat* us, GLfloat* radii, const size_t count, const glm::vec2& p1, const glm::vec2& p2);
+
+//subdivisions of every segment along u (rows) and around the axis (steps)
+struct Tessellation {
+    int rows = 0;
+    int steps = 0;
+    bool operator==(const Tessellation&) const = default;
+};
+
+//The revolved segment is a cone frustum, which is linear in u, so a single
+//row is exact. The steps keep the chord error r * (1 - cos(pi / steps)) below
+//chordError * r for every radius r.
+Tessellation exactTessellation(const float chordError);
+
+//number of lattice points revolveSegment() writes
+inline size_t segmentVertexCount(const Tessellation& tessellation) { return (size_t)(tessellation.rows + 1) * tessellation.steps; }
+
+//writes the (rows + 1) x ring.steps lattice of the segment p1-p2 as xyz
+//triplets, row by row, with the same points S() gives; the first and last
+//rows are exactly at the end points
+void revolveSegment(GLfloat* out, const AngularRing& ring, const int row_count, const glm::vec2& p1, const glm::vec2& p2);
+
+//times S() against revolveSegment() and prints the results
+void benchmarkRevolution();
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "mesh.h"
+#include "revolution.h"
+
+//end points of one profile segment
+typedef std::array<glm::vec2, 2> SegmentEnds;
+
+//The ruled surface on the CPU, kept per profile segment so an edit only
+//rebuilds the segments whose end points changed. Segment k always occupies
+//the same range of vertices and indices, so it is replaced in place.
+//It touches no OpenGL state and can be built on any thread. The mesh may be
+//shared with snapshots, such as a running export; an update then copies it
+//first, so a snapshot never changes.
+struct RuledGeometry {
+    Tessellation tessellation;
+    AngularRing ring;
+    //end points every stored segment was built from
+    std::vector<SegmentEnds> segments;
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+};
+
+//The ruled surface on the GPU, with the same per segment layout.
+struct RuledMesh {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    Tessellation tessellation;
+    size_t capacity = 0; //segments the buffers have room for
+    //end points of the segments currently in the buffers
+    std::vector<SegmentEnds> segments;
+};
+
+inline size_t segmentIndexCount(const Tessellation& tessellation) { return 6 * (size_t)tessellation.rows * tessellation.steps; }
+
+//writes the lattice of the segment p1-p2 and the triangles connecting it;
+//the indices start at vertex first
+void createRuled(GLfloat* vertices, GLuint* indices, const GLuint first, const AngularRing& ring, const int row_count, const glm::vec2& p1, const glm::vec2& p2);
+
+//Rebuilds the segments of editorVertices that differ from the stored ones.
+//Returns false when cancelled() turned true first; the segments that were not
+//finished are then rebuilt by the next update.
+bool updateRuledGeometry(RuledGeometry& geometry, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices,
+    const std::function<bool()>& cancelled = [] { return false; });
+
+//number of values updateRuledGeometry() would write, a measure of its cost
+size_t ruledGeometryWork(const RuledGeometry& geometry, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices);
+
+void initRuledMesh(RuledMesh& mesh);
+
+//uploads the segments of geometry that are not already in the buffers
+void uploadRuledMesh(RuledMesh& mesh, const RuledGeometry& geometry);
+
+void deleteRuledMesh(RuledMesh& mesh);
+
+inline GLsizei ruledMeshVertexCount(const RuledMesh& mesh) { return (GLsizei)(mesh.segments.size() * segmentVertexCount(mesh.tessellation)); }
+inline GLsizei ruledMeshIndexCount(const RuledMesh& mesh) { return (GLsizei)(mesh.segments.size() * segmentIndexCount(mesh.tessellation)); }
+
+//Welds the surface of a closed profile, one that starts and ends on the axis,
+//in both tessellation modes and prints whether every edge is shared by exactly
+//two triangles. False when one is not.
+bool checkWatertight();
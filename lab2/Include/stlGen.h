@@ -0,0 +1,9 @@
+#pragma once
+
+
+#include "mesh.h"
+#include <string>
+
+//progress, if given, is updated as the file is written and can cancel it,
+//in which case the partial file is removed
+void SaveSTL(const Mesh& mesh, std::string filename, ExportProgress* progress = nullptr);
@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <queue>
+
+#include "exportFile.h"
+
+//uncompressed bytes handed to the gzip stage at a time
+const size_t gzipBlockSize = 1 << 20;
+//blocks per worker in the gzip stage before the exporter waits instead
+const size_t gzipQueuedBlocksPerWorker = 2;
+
+//deflate can refer back this far
+const size_t deflateWindow = 1 << 15;
+const size_t minMatch = 3;
+const size_t maxMatch = 258;
+//candidates tried per position, trading ratio for speed
+const int maxChain = 16;
+
+static const std::array<uint16_t, 29> lengthBase{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const std::array<uint8_t, 29> lengthExtra{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const std::array<uint16_t, 30> distanceBase{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+static const std::array<uint8_t, 30> distanceExtra{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+//Deflate with LZ77 matches found through hash chains and Huffman codes built
+//for every block. One deflate block per input block, with the end of the
+//data before it as history, so every block can be deflated on its own.
+struct Deflater {
+    std::vector<uint8_t> data; //the window followed by the block
+    std::vector<int> head;
+    std::vector<int> prev;
+    std::vector<uint32_t> tokens; //a literal byte, or length << 16 | distance
+    std::vector<uint8_t> out;
+    uint64_t bits = 0;
+    int bitCount = 0;
+};
+
+//per symbol, the length of its code and the code reversed for putBits
+struct HuffmanCode {
+    std::vector<uint8_t> lengths;
+    std::vector<uint32_t> codes;
+};
+
+void submitBlock(ExportFile& file, const bool last);
+void gzipWorker(GzipStage& gzip);
+void gzipWriter(GzipStage& gzip, std::ofstream& file);
+void deflateBlock(Deflater& deflater, const std::vector<char>& block, const bool last);
+void findMatches(Deflater& deflater, const size_t start);
+HuffmanCode buildHuffmanCode(std::vector<uint32_t> frequencies, const int maxLength);
+void putBits(Deflater& deflater, uint32_t value, int count);
+void putSymbol(Deflater& deflater, const HuffmanCode& code, size_t symbol);
+size_t lengthSymbol(size_t length);
+size_t distanceSymbol(size_t distance);
+uint32_t updateCrc32(uint32_t crc, const std::vector<char>& bytes);
+
+bool openExportFile(ExportFile& file, const std::string& filename, ExportProgress* progress, const bool text) {
+    const auto compressed = filename.ends_with(".gz");
+    file.file.open(filename, text && !compressed ? std::ios::out : std::ios::out | std::ios::binary);
+    if (!file.file.is_open()) {
+        if (progress != nullptr) progress->failed = true;
+        return false;
+    }
+    if (!compressed) return true;
+
+    //no name, time or flags; OS unknown
+    const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+    file.file.write(header, sizeof(header));
+    file.block.reserve(gzipBlockSize);
+    file.gzip = std::make_unique<GzipStage>();
+    auto& gzip = *file.gzip;
+    const auto workerCount = std::max(1u, std::thread::hardware_concurrency());
+    gzip.maxBlocks = gzipQueuedBlocksPerWorker * workerCount;
+    for (unsigned worker = 0; worker < workerCount; worker++) gzip.workers.emplace_back(gzipWorker, std::ref(gzip));
+    gzip.writer = std::thread(gzipWriter, std::ref(gzip), std::ref(file.file));
+    return true;
+}
+
+void submitBlock(ExportFile& file, const bool last) {
+    auto& gzip = *file.gzip;
+    auto block = std::make_shared<GzipBlock>();
+    block->data = std::move(file.block);
+    block->window = gzip.window;
+    block->last = last;
+    //the history of the next block is the end of this one, topped up from before it
+    const auto& data = block->data;
+    const auto fromData = std::min(deflateWindow, data.size());
+    gzip.window.erase(gzip.window.begin(), gzip.window.end() - std::min(gzip.window.size(), deflateWindow - fromData));
+    gzip.window.insert(gzip.window.end(), data.end() - fromData, data.end());
+    {
+        std::unique_lock lock(gzip.mutex);
+        gzip.changed.wait(lock, [&]() { return gzip.blocks.size() < gzip.maxBlocks; });
+        gzip.blocks.push_back(std::move(block));
+        gzip.closed = last;
+    }
+    gzip.changed.notify_all();
+    file.block = std::vector<char>();
+    file.block.reserve(gzipBlockSize);
+}
+
+void writeExportFile(ExportFile& file, const char* data, size_t size) {
+    if (!file.gzip) {
+        file.file.write(data, size);
+        return;
+    }
+    while (size > 0) {
+        const auto count = std::min(size, gzipBlockSize - file.block.size());
+        file.block.insert(file.block.end(), data, data + count);
+        data += count;
+        size -= count;
+        if (file.block.size() == gzipBlockSize) submitBlock(file, false);
+    }
+}
+
+bool finishExportFile(ExportFile& file, const std::string& filename, ExportProgress* progress) {
+    if (file.gzip) {
+        auto& gzip = *file.gzip;
+        if (!file.block.empty()) submitBlock(file, false);
+        submitBlock(file, true);
+        gzip.writer.join();
+        for (auto& worker : gzip.workers) worker.join();
+        //little-endian CRC-32 and size
+        const char trailer[8] = {
+            (char)gzip.crc, (char)(gzip.crc >> 8), (char)(gzip.crc >> 16), (char)(gzip.crc >> 24),
+            (char)gzip.size, (char)(gzip.size >> 8), (char)(gzip.size >> 16), (char)(gzip.size >> 24)
+        };
+        file.file.write(trailer, sizeof(trailer));
+        file.gzip.reset();
+    }
+    //a full disk may only show when the last bytes are flushed
+    file.file.close();
+    const auto failed = file.file.fail();
+    if (failed && progress != nullptr) progress->failed = true;
+    if (!failed && (progress == nullptr || !progress->cancelled)) return true;
+    std::error_code error;
+    std::filesystem::remove(filename, error);
+    return false;
+}
+
+void gzipWorker(GzipStage& gzip) {
+    Deflater deflater;
+    while (true) {
+        std::shared_ptr<GzipBlock> block;
+        {
+            std::unique_lock lock(gzip.mutex);
+            gzip.changed.wait(lock, [&]() { return gzip.taken < gzip.blocks.size() || gzip.closed; });
+            //closed and every block taken
+            if (gzip.taken == gzip.blocks.size()) return;
+            block = gzip.blocks[gzip.taken++];
+        }
+        deflater.data.assign(block->window.begin(), block->window.end());
+        deflateBlock(deflater, block->data, block->last);
+        {
+            std::lock_guard lock(gzip.mutex);
+            block->out = std::move(deflater.out);
+            block->deflated = true;
+        }
+        deflater.out = std::vector<uint8_t>();
+        gzip.changed.notify_all();
+    }
+}
+
+//Writes the deflated blocks in the order they were submitted.
+void gzipWriter(GzipStage& gzip, std::ofstream& file) {
+    uint32_t crc = 0xffffffff;
+    while (true) {
+        std::shared_ptr<GzipBlock> block;
+        {
+            std::unique_lock lock(gzip.mutex);
+            gzip.changed.wait(lock, [&]() { return !gzip.blocks.empty() && gzip.blocks.front()->deflated; });
+            block = std::move(gzip.blocks.front());
+            gzip.blocks.pop_front();
+            gzip.taken--;
+        }
+        gzip.changed.notify_all();
+
+        crc = updateCrc32(crc, block->data);
+        gzip.size += (uint32_t)block->data.size();
+        file.write((const char*)block->out.data(), block->out.size());
+        if (block->last) break;
+    }
+    gzip.crc = crc ^ 0xffffffff;
+}
+
+void deflateBlock(Deflater& deflater, const std::vector<char>& block, const bool last) {
+    auto& data = deflater.data;
+    const auto start = data.size();
+    data.insert(data.end(), block.begin(), block.end());
+    findMatches(deflater, start);
+
+    std::vector<uint32_t> literalFrequencies(286), distanceFrequencies(30);
+    for (const auto token : deflater.tokens) {
+        if (token < 256) literalFrequencies[token]++;
+        else {
+            literalFrequencies[257 + lengthSymbol(token >> 16)]++;
+            distanceFrequencies[distanceSymbol(token & 0xffff)]++;
+        }
+    }
+    literalFrequencies[256] = 1; //end of block
+    const auto literalCode = buildHuffmanCode(literalFrequencies, 15);
+    const auto distanceCode = buildHuffmanCode(distanceFrequencies, 15);
+
+    //Both codes are sent as their lengths, run-length encoded: 16 repeats the
+    //previous length 3-6 times, 17 and 18 repeat zero 3-10 and 11-138 times.
+    size_t literalCount = 286, distanceCount = 30;
+    while (literalCode.lengths[literalCount - 1] == 0) literalCount--;
+    while (distanceCode.lengths[distanceCount - 1] == 0) distanceCount--;
+    std::vector<uint8_t> lengths(literalCode.lengths.begin(), literalCode.lengths.begin() + literalCount);
+    lengths.insert(lengths.end(), distanceCode.lengths.begin(), distanceCode.lengths.begin() + distanceCount);
+    std::vector<std::array<uint8_t, 2>> runs; //symbol and extra bits
+    for (size_t i = 0; i < lengths.size();) {
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == lengths[i]) run++;
+        if (lengths[i] == 0 && run >= 3) {
+            run = std::min<size_t>(run, 138);
+            runs.push_back(run >= 11 ? std::array<uint8_t, 2>{ 18, (uint8_t)(run - 11) } : std::array<uint8_t, 2>{ 17, (uint8_t)(run - 3) });
+        }
+        else if (lengths[i] != 0 && run >= 4) {
+            run = std::min<size_t>(run, 7);
+            runs.push_back({ lengths[i], 0 });
+            runs.push_back({ 16, (uint8_t)(run - 4) });
+        }
+        else {
+            run = 1;
+            runs.push_back({ lengths[i], 0 });
+        }
+        i += run;
+    }
+    std::vector<uint32_t> runFrequencies(19);
+    for (const auto& run : runs) runFrequencies[run[0]]++;
+    const auto runCode = buildHuffmanCode(runFrequencies, 7);
+    static const std::array<uint8_t, 19> runOrder{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    size_t runCount = 19;
+    while (runCount > 4 && runCode.lengths[runOrder[runCount - 1]] == 0) runCount--;
+
+    //BFINAL, then BTYPE 2 for codes of our own
+    putBits(deflater, (last ? 1 : 0) | 2 << 1, 3);
+    putBits(deflater, (uint32_t)(literalCount - 257), 5);
+    putBits(deflater, (uint32_t)(distanceCount - 1), 5);
+    putBits(deflater, (uint32_t)(runCount - 4), 4);
+    for (size_t i = 0; i < runCount; i++) putBits(deflater, runCode.lengths[runOrder[i]], 3);
+    static const std::array<uint8_t, 3> runExtra{ 2, 3, 7 };
+    for (const auto& run : runs) {
+        putSymbol(deflater, runCode, run[0]);
+        if (run[0] >= 16) putBits(deflater, run[1], runExtra[run[0] - 16]);
+    }
+
+    for (const auto token : deflater.tokens) {
+        if (token < 256) {
+            putSymbol(deflater, literalCode, token);
+            continue;
+        }
+        const size_t length = token >> 16, distance = token & 0xffff;
+        const auto l = lengthSymbol(length), d = distanceSymbol(distance);
+        putSymbol(deflater, literalCode, 257 + l);
+        putBits(deflater, (uint32_t)(length - lengthBase[l]), lengthExtra[l]);
+        putSymbol(deflater, distanceCode, d);
+        putBits(deflater, (uint32_t)(distance - distanceBase[d]), distanceExtra[d]);
+    }
+    putSymbol(deflater, literalCode, 256);
+
+    if (!last) {
+        //an empty stored block ends on a byte boundary, so blocks deflated
+        //apart can be written one after the other
+        putBits(deflater, 0, 3);
+        if (deflater.bitCount > 0) putBits(deflater, 0, 8 - deflater.bitCount);
+        putBits(deflater, 0xffff0000, 32);
+    }
+    else if (deflater.bitCount > 0) putBits(deflater, 0, 8 - deflater.bitCount);
+    //keep only the window for the next block
+    if (data.size() > deflateWindow) data.erase(data.begin(), data.end() - deflateWindow);
+}
+
+//Greedy LZ77 over the block, matching into the window before it too.
+void findMatches(Deflater& deflater, const size_t start) {
+    const auto& data = deflater.data;
+    const auto end = data.size();
+    deflater.tokens.clear();
+
+    //the chains restart from the window every block
+    const auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & (deflateWindow - 1); };
+    deflater.head.assign(deflateWindow, -1);
+    deflater.prev.resize(end);
+    const auto insert = [&](size_t i) {
+        if (i + minMatch > end) return;
+        auto& first = deflater.head[hash(i)];
+        deflater.prev[i] = first;
+        first = (int)i;
+    };
+    for (size_t i = 0; i < start; i++) insert(i);
+
+    for (size_t i = start; i < end;) {
+        size_t bestLength = 0, bestDistance = 0;
+        if (i + minMatch <= end) {
+            const auto longest = std::min(maxMatch, end - i);
+            auto candidate = deflater.head[hash(i)];
+            for (int chain = 0; chain < maxChain && candidate >= 0 && i - candidate <= deflateWindow; chain++) {
+                size_t length = 0;
+                while (length < longest && data[candidate + length] == data[i + length]) length++;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == longest) break;
+                }
+                candidate = deflater.prev[candidate];
+            }
+        }
+        if (bestLength >= minMatch) {
+            deflater.tokens.push_back((uint32_t)(bestLength << 16 | bestDistance));
+            for (const auto matchEnd = i + bestLength; i < matchEnd; i++) insert(i);
+        }
+        else {
+            deflater.tokens.push_back(data[i]);
+            insert(i++);
+        }
+    }
+}
+
+//Huffman code no longer than maxLength, by flattening the frequencies until
+//the tree is shallow enough.
+HuffmanCode buildHuffmanCode(std::vector<uint32_t> frequencies, const int maxLength) {
+    //a code needs two symbols; unused ones only cost their length in the header
+    for (size_t s = 0; (size_t)std::count(frequencies.begin(), frequencies.end(), 0u) + 2 > frequencies.size(); s++) {
+        if (frequencies[s] == 0) frequencies[s] = 1;
+    }
+
+    const auto n = frequencies.size();
+    HuffmanCode code{ std::vector<uint8_t>(n), std::vector<uint32_t>(n) };
+    while (true) {
+        //the leaves, then the merged nodes in the order they are made
+        std::vector<uint64_t> weights(frequencies.begin(), frequencies.end());
+        std::vector<size_t> parents(n);
+        typedef std::pair<uint64_t, size_t> Node;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        for (size_t s = 0; s < n; s++) if (frequencies[s] > 0) queue.push({ frequencies[s], s });
+        while (queue.size() > 1) {
+            const auto a = queue.top();
+            queue.pop();
+            const auto b = queue.top();
+            queue.pop();
+            parents[a.second] = parents[b.second] = weights.size();
+            weights.push_back(a.first + b.first);
+            parents.push_back(0);
+            queue.push({ weights.back(), weights.size() - 1 });
+        }
+        //parents come after their children and the root is last
+        std::vector<int> depths(weights.size());
+        for (size_t i = weights.size() - 1; i-- > 0;) depths[i] = depths[parents[i]] + 1;
+        int longest = 0;
+        for (size_t s = 0; s < n; s++) {
+            code.lengths[s] = frequencies[s] > 0 ? (uint8_t)depths[s] : 0;
+            longest = std::max<int>(longest, code.lengths[s]);
+        }
+        if (longest <= maxLength) break;
+        for (auto& frequency : frequencies) if (frequency > 0) frequency = (frequency + 1) / 2;
+    }
+
+    //canonical codes: shorter first, then in symbol order
+    std::array<uint32_t, 16> counts{}, next{};
+    for (const auto length : code.lengths) if (length > 0) counts[length]++;
+    for (int length = 1; length < 16; length++) next[length] = (next[length - 1] + counts[length - 1]) << 1;
+    for (size_t s = 0; s < n; s++) {
+        const auto length = code.lengths[s];
+        if (length == 0) continue;
+        const auto value = next[length]++;
+        //Huffman codes go most significant bit first
+        for (int b = 0; b < length; b++) code.codes[s] |= ((value >> b) & 1) << (length - 1 - b);
+    }
+    return code;
+}
+
+//deflate packs bits from the least significant one up
+void putBits(Deflater& deflater, uint32_t value, int count) {
+    deflater.bits |= (uint64_t)value << deflater.bitCount;
+    deflater.bitCount += count;
+    while (deflater.bitCount >= 8) {
+        deflater.out.push_back((uint8_t)deflater.bits);
+        deflater.bits >>= 8;
+        deflater.bitCount -= 8;
+    }
+}
+
+void putSymbol(Deflater& deflater, const HuffmanCode& code, size_t symbol) {
+    putBits(deflater, code.codes[symbol], code.lengths[symbol]);
+}
+
+size_t lengthSymbol(size_t length) {
+    return std::upper_bound(lengthBase.begin(), lengthBase.end(), length) - lengthBase.begin() - 1;
+}
+
+size_t distanceSymbol(size_t distance) {
+    return std::upper_bound(distanceBase.begin(), distanceBase.end(), distance) - distanceBase.begin() - 1;
+}
+
+uint32_t updateCrc32(uint32_t crc, const std::vector<char>& bytes) {
+    static const auto table = []() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < table.size(); i++) {
+            auto value = i;
+            for (int bit = 0; bit < 8; bit++) value = value & 1 ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+        return table;
+    }();
+    for (const auto byte : bytes) crc = table[(crc ^ (uint8_t)byte) & 0xff] ^ (crc >> 8);
+    return crc;
+}
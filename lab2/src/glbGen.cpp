@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "exportFile.h"
+#include "glbGen.h"
+
+
+using namespace std;
+
+//simulated cache of the vertex cache optimization
+const int cacheSize = 32;
+
+const std::vector<GLuint> OptimizeVertexCache(const Mesh& mesh, ExportProgress* progress);
+float VertexScore(const int cachePosition, const uint32_t remaining);
+std::string JsonFloat(const float value);
+
+//Binary glTF with KHR_mesh_quantization: welded vertices with positions as
+//16-bit integers, scaled back by the node, and normals as normalized bytes,
+//in one buffer. The triangles are reordered for the vertex cache and the
+//vertices in the order the triangles first use them.
+void SaveGLB(const Mesh& mesh, std::string filename, ExportProgress* progress) {
+	static_assert(std::endian::native == std::endian::little, "the GLB is written in the native byte order");
+	const auto exported = startExport(mesh, progress);
+	if (!exported) return;
+	const auto& welded = *exported;
+
+	const auto ordered = OptimizeVertexCache(welded, progress);
+	if (progress != nullptr && progress->cancelled) return;
+	std::vector<GLuint> remap(meshVertexCount(welded), UINT32_MAX);
+	std::vector<GLuint> vertices; //welded index of every written vertex
+	std::vector<GLuint> indices(ordered.size());
+	for (size_t i = 0; i < ordered.size(); i++) {
+		auto& index = remap[ordered[i]];
+		if (index == UINT32_MAX) {
+			index = (GLuint)vertices.size();
+			vertices.push_back(ordered[i]);
+		}
+		indices[i] = index;
+	}
+	const auto vertexCount = vertices.size();
+	//glTF has no empty accessors or buffer views, so there is no valid file to write
+	if (indices.empty()) {
+		if (progress != nullptr) progress->failed = true;
+		return;
+	}
+
+	//area weighted normals
+	std::vector<glm::vec3> normals(meshVertexCount(welded), glm::vec3(0.0f));
+	const auto position = [&](GLuint index) { return glm::vec3(welded.positions[3 * index], welded.positions[3 * index + 1], welded.positions[3 * index + 2]); };
+	for (size_t t = 0; t < welded.indices.size(); t += 3) {
+		const auto a = welded.indices[t], b = welded.indices[t + 1], c = welded.indices[t + 2];
+		const auto normal = glm::cross(position(b) - position(a), position(c) - position(a));
+		normals[a] += normal;
+		normals[b] += normal;
+		normals[c] += normal;
+	}
+
+	//one scale for all axes keeps the normals valid under the node transform
+	glm::vec3 low(INFINITY), high(-INFINITY);
+	for (const auto v : vertices) {
+		low = glm::min(low, position(v));
+		high = glm::max(high, position(v));
+	}
+	const auto extent = std::max({ high.x - low.x, high.y - low.y, high.z - low.z });
+	const auto scale = extent > 0 ? extent / 65535.0f : 1.0f;
+
+	//positions and normals padded to 8 and 4 bytes, as vertex strides must be
+	std::vector<uint16_t> quantized(4 * vertexCount, 0);
+	std::vector<int8_t> packedNormals(4 * vertexCount, 0);
+	std::array<uint16_t, 3> quantizedHigh{};
+	for (size_t i = 0; i < vertexCount; i++) {
+		const auto p = (position(vertices[i]) - low) / scale;
+		const auto length = glm::length(normals[vertices[i]]);
+		const auto n = length > 0 ? normals[vertices[i]] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		for (int c = 0; c < 3; c++) {
+			quantized[4 * i + c] = (uint16_t)std::clamp(std::lround(p[c]), 0l, 65535l);
+			quantizedHigh[c] = std::max(quantizedHigh[c], quantized[4 * i + c]);
+			packedNormals[4 * i + c] = (int8_t)std::lround(n[c] * 127.0f);
+		}
+	}
+
+	//the largest value of the index type is reserved for primitive restart
+	const auto shortIndices = vertexCount < 65536;
+	const size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	std::vector<char> indexBytes(indices.size() * indexSize);
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (shortIndices) {
+			const auto index = (uint16_t)indices[i];
+			std::memcpy(&indexBytes[i * indexSize], &index, indexSize);
+		}
+		else std::memcpy(&indexBytes[i * indexSize], &indices[i], indexSize);
+	}
+
+	const auto positionBytes = quantized.size() * sizeof(uint16_t);
+	const auto normalBytes = packedNormals.size();
+	const auto indexPadding = (4 - indexBytes.size() % 4) % 4;
+	const auto bufferBytes = positionBytes + normalBytes + indexBytes.size() + indexPadding;
+
+	std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"made by Bedrich Benes bbenes@purdue.edu\"},";
+	json += "\"extensionsUsed\":[\"KHR_mesh_quantization\"],\"extensionsRequired\":[\"KHR_mesh_quantization\"],";
+	json += "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],";
+	json += "\"nodes\":[{\"mesh\":0,\"translation\":[" + JsonFloat(low.x) + "," + JsonFloat(low.y) + "," + JsonFloat(low.z) + "],";
+	json += "\"scale\":[" + JsonFloat(scale) + "," + JsonFloat(scale) + "," + JsonFloat(scale) + "]}],";
+	json += "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2,\"material\":0}]}],";
+	json += "\"materials\":[{\"doubleSided\":true,\"pbrMetallicRoughness\":{\"metallicFactor\":0}}],";
+	json += "\"buffers\":[{\"byteLength\":" + to_string(bufferBytes) + "}],";
+	json += "\"bufferViews\":[";
+	json += "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + to_string(positionBytes) + ",\"byteStride\":8,\"target\":34962},";
+	json += "{\"buffer\":0,\"byteOffset\":" + to_string(positionBytes) + ",\"byteLength\":" + to_string(normalBytes) + ",\"byteStride\":4,\"target\":34962},";
+	json += "{\"buffer\":0,\"byteOffset\":" + to_string(positionBytes + normalBytes) + ",\"byteLength\":" + to_string(indexBytes.size()) + ",\"target\":34963}],";
+	json += "\"accessors\":[";
+	json += "{\"bufferView\":0,\"componentType\":5123,\"type\":\"VEC3\",\"count\":" + to_string(vertexCount) + ",\"min\":[0,0,0],\"max\":[" +
+		to_string(quantizedHigh[0]) + "," + to_string(quantizedHigh[1]) + "," + to_string(quantizedHigh[2]) + "]},";
+	json += "{\"bufferView\":1,\"componentType\":5120,\"normalized\":true,\"type\":\"VEC3\",\"count\":" + to_string(vertexCount) + "},";
+	json += "{\"bufferView\":2,\"componentType\":" + std::string(shortIndices ? "5123" : "5125") + ",\"type\":\"SCALAR\",\"count\":" + to_string(indices.size()) + "}]}";
+	//chunks are 4 byte aligned, JSON with spaces
+	json.append((4 - json.size() % 4) % 4, ' ');
+
+	const auto chunkHeader = [](uint32_t length, const char* type) {
+		std::array<char, 8> header{};
+		std::memcpy(&header[0], &length, 4);
+		std::memcpy(&header[4], type, 4);
+		return header;
+	};
+	ExportFile myfile;
+	if (!openExportFile(myfile, filename, progress)) return;
+
+	const uint32_t header[3] = { 0x46546c67, 2, (uint32_t)(12 + 8 + json.size() + 8 + bufferBytes) }; //"glTF", version 2
+	writeExportFile(myfile, (const char*)header, sizeof(header));
+	writeExportFile(myfile, chunkHeader((uint32_t)json.size(), "JSON").data(), 8);
+	writeExportFile(myfile, json);
+	writeExportFile(myfile, chunkHeader((uint32_t)bufferBytes, "BIN\0").data(), 8);
+	writeExportFile(myfile, (const char*)quantized.data(), positionBytes);
+	writeExportFile(myfile, (const char*)packedNormals.data(), normalBytes);
+	writeExportFile(myfile, indexBytes.data(), indexBytes.size());
+	writeExportFile(myfile, "\0\0\0", indexPadding);
+	if (progress != nullptr) {
+		progress->done += meshVertexCount(welded);
+		progress->bytes += bufferBytes;
+	}
+	finishExportFile(myfile, filename, progress);
+
+}
+
+//Tom Forsyth's linear-speed vertex cache optimisation: emits the triangle
+//with the best score next, where the vertices score for being recently used
+//and for having few triangles left. Only the triangles of the vertices in the
+//cache are rescored after each step.
+const std::vector<GLuint> OptimizeVertexCache(const Mesh& mesh, ExportProgress* progress) {
+	const auto vertexCount = meshVertexCount(mesh);
+	const auto triangleCount = meshTriangleCount(mesh);
+
+	//the triangles of every vertex, the ones left in front
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (const auto index : mesh.indices) remaining[index]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(mesh.indices.size());
+	{
+		auto next = offsets;
+		for (size_t i = 0; i < mesh.indices.size(); i++) adjacency[next[mesh.indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vertexScores[v] = VertexScore(-1, remaining[v]);
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScores[t] = vertexScores[mesh.indices[3 * t]] + vertexScores[mesh.indices[3 * t + 1]] + vertexScores[mesh.indices[3 * t + 2]];
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<GLuint> ordered;
+	ordered.reserve(mesh.indices.size());
+	std::vector<GLuint> cache, nextCache;
+	int64_t best = triangleCount > 0 ? std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin() : -1;
+	size_t firstLeft = 0; //no triangle before it is left
+	for (size_t step = 0; step < triangleCount; step++) {
+		if (progress != nullptr && (step & 0xffff) == 0) {
+			if (progress->cancelled) return {};
+			progress->done += std::min<size_t>(0x10000, triangleCount - step);
+		}
+		//the cache has nothing left to use, so start over anywhere
+		if (best < 0) {
+			while (emitted[firstLeft]) firstLeft++;
+			best = firstLeft;
+		}
+		emitted[best] = true;
+		const auto triangle = &mesh.indices[3 * best];
+		ordered.insert(ordered.end(), triangle, triangle + 3);
+
+		for (int c = 0; c < 3; c++) {
+			const auto v = triangle[c];
+			const auto first = adjacency.begin() + offsets[v];
+			std::iter_swap(std::find(first, first + remaining[v], (uint32_t)best), first + remaining[v] - 1);
+			remaining[v]--;
+		}
+		//the triangle's vertices move to the front
+		nextCache.assign(triangle, triangle + 3);
+		for (const auto v : cache) if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+
+		//rescore, including the vertices pushed out of the cache
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			const auto v = nextCache[i];
+			const auto score = VertexScore(i < cacheSize ? (int)i : -1, remaining[v]);
+			const auto change = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (auto t = offsets[v]; t < offsets[v] + remaining[v]; t++) triangleScores[adjacency[t]] += change;
+		}
+		nextCache.resize(std::min<size_t>(nextCache.size(), cacheSize));
+		std::swap(cache, nextCache);
+
+		best = -1;
+		for (const auto v : cache) {
+			for (auto t = offsets[v]; t < offsets[v] + remaining[v]; t++) {
+				if (best < 0 || triangleScores[adjacency[t]] > triangleScores[best]) best = adjacency[t];
+			}
+		}
+	}
+	return ordered;
+}
+
+float VertexScore(const int cachePosition, const uint32_t remaining) {
+	if (remaining == 0) return -1.0f;
+	float score = 0.0f;
+	//the last triangle's vertices score the same, whatever order they came in
+	if (cachePosition >= 0) score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (cachePosition - 3) / (float)(cacheSize - 3), 1.5f);
+	//vertices with few triangles left are worth finishing
+	return score + 2.0f / std::sqrt((float)remaining);
+}
+
+std::string JsonFloat(const float value) {
+	char text[32];
+	return std::string(text, std::to_chars(text, text + sizeof(text), value).ptr);
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "exportFile.h"
+
+//Reads a deflate stream a bit at a time, least significant bit first. Reading
+//past the end sets failed instead.
+struct BitReader {
+    const std::vector<char>& bytes;
+    size_t position;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    bool failed = false;
+};
+
+//canonical Huffman code as the number of codes of each length and the symbols
+//in code order
+struct InflateCode {
+    std::array<uint16_t, 16> counts{};
+    std::vector<uint16_t> symbols;
+};
+
+std::optional<std::vector<char>> gunzip(const std::vector<char>& file);
+uint32_t readBits(BitReader& reader, const int count);
+InflateCode buildInflateCode(const uint8_t* lengths, const size_t count);
+int decodeSymbol(BitReader& reader, const InflateCode& code);
+bool inflateCodes(BitReader& reader, const InflateCode& literalCode, const InflateCode& distanceCode,
+    std::vector<char>& out);
+uint32_t bitwiseCrc32(const std::vector<char>& bytes);
+
+bool checkGzipRoundTrip() {
+    std::mt19937 random(535);
+    std::vector<std::pair<std::string, std::vector<char>>> cases;
+    cases.push_back({ "empty", {} });
+    //OBJ lines over several blocks, the last one partial
+    std::string text;
+    for (int v = 0; text.size() < 3500000; v++)
+        text += "v " + std::to_string(std::sin(v * 0.01)) + " " + std::to_string(v * 0.001) + " " + std::to_string(std::cos(v * 0.01)) + "\n";
+    cases.push_back({ "text", std::vector<char>(text.begin(), text.end()) });
+    //nothing to match, and every byte value about as likely
+    std::vector<char> noise(1500000);
+    for (auto& byte : noise) byte = (char)random();
+    cases.push_back({ "noise", noise });
+    //the longest matches at the shortest distance, across a block boundary
+    cases.push_back({ "zeros", std::vector<char>((2 << 20) + 1, 0) });
+
+    const auto path = std::filesystem::temp_directory_path() / "lab2-check.gz";
+    bool passed = true;
+    for (const auto& [name, data] : cases) {
+        ExportFile file;
+        auto written = openExportFile(file, path.string(), nullptr);
+        //pieces of odd sizes, as the exporters write them
+        for (size_t offset = 0; written && offset < data.size();) {
+            const auto count = std::min<size_t>(random() % 70000 + 1, data.size() - offset);
+            writeExportFile(file, data.data() + offset, count);
+            offset += count;
+        }
+        written = written && finishExportFile(file, path.string(), nullptr);
+
+        std::vector<char> compressed;
+        if (written) {
+            std::ifstream input(path, std::ios::binary);
+            compressed.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+        const auto restored = gunzip(compressed);
+        const auto ok = restored && *restored == data;
+        std::cout << "gzip " << name << ": " << data.size() << " bytes to " << compressed.size()
+                  << (ok ? ", restored" : ", NOT restored") << std::endl;
+        if (!ok) passed = false;
+    }
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return passed;
+}
+
+//Only the gzip files openExportFile() writes: no name, comment or extra field.
+std::optional<std::vector<char>> gunzip(const std::vector<char>& file) {
+    if (file.size() < 18 || (uint8_t)file[0] != 0x1f || (uint8_t)file[1] != 0x8b || file[2] != 8 || file[3] != 0)
+        return std::nullopt;
+
+    BitReader reader{ file, 10 };
+    std::vector<char> out;
+    static const std::array<uint8_t, 19> lengthOrder{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    bool final = false;
+    while (!final && !reader.failed) {
+        final = readBits(reader, 1) == 1;
+        const auto type = readBits(reader, 2);
+        if (type == 0) {
+            //stored: the rest of the byte is skipped, then the length and its complement
+            reader.bits = 0;
+            reader.bitCount = 0;
+            const auto length = readBits(reader, 16);
+            if (readBits(reader, 16) != (~length & 0xffff) || reader.position + length > file.size()) return std::nullopt;
+            out.insert(out.end(), file.begin() + reader.position, file.begin() + reader.position + length);
+            reader.position += length;
+        }
+        else if (type == 1) {
+            std::array<uint8_t, 288 + 30> lengths{};
+            std::fill(lengths.begin(), lengths.begin() + 144, 8);
+            std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+            std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+            std::fill(lengths.begin() + 280, lengths.begin() + 288, 8);
+            std::fill(lengths.begin() + 288, lengths.end(), 5);
+            if (!inflateCodes(reader, buildInflateCode(lengths.data(), 288), buildInflateCode(lengths.data() + 288, 30), out))
+                return std::nullopt;
+        }
+        else if (type == 2) {
+            const auto literalCount = readBits(reader, 5) + 257;
+            const auto distanceCount = readBits(reader, 5) + 1;
+            const auto lengthCodeCount = readBits(reader, 4) + 4;
+            std::array<uint8_t, 19> lengthCodeLengths{};
+            for (size_t i = 0; i < lengthCodeCount; i++) lengthCodeLengths[lengthOrder[i]] = (uint8_t)readBits(reader, 3);
+            const auto lengthCode = buildInflateCode(lengthCodeLengths.data(), lengthCodeLengths.size());
+
+            std::vector<uint8_t> lengths;
+            while (lengths.size() < literalCount + distanceCount && !reader.failed) {
+                const auto symbol = decodeSymbol(reader, lengthCode);
+                if (symbol < 0) return std::nullopt;
+                if (symbol < 16) {
+                    lengths.push_back((uint8_t)symbol);
+                    continue;
+                }
+                if (symbol == 16 && lengths.empty()) return std::nullopt;
+                const auto repeated = symbol == 16 ? lengths.back() : 0;
+                const auto count = symbol == 16 ? 3 + readBits(reader, 2) : symbol == 17 ? 3 + readBits(reader, 3) : 11 + readBits(reader, 7);
+                lengths.insert(lengths.end(), count, repeated);
+            }
+            if (lengths.size() != literalCount + distanceCount || lengths[256] == 0) return std::nullopt;
+            if (!inflateCodes(reader, buildInflateCode(lengths.data(), literalCount),
+                    buildInflateCode(lengths.data() + literalCount, distanceCount), out))
+                return std::nullopt;
+        }
+        else return std::nullopt;
+    }
+    if (reader.failed || reader.position + 8 != file.size()) return std::nullopt;
+
+    //the trailer is byte aligned after the last block
+    uint32_t crc = 0, size = 0;
+    for (int i = 0; i < 4; i++) crc |= (uint32_t)(uint8_t)file[reader.position + i] << (8 * i);
+    for (int i = 0; i < 4; i++) size |= (uint32_t)(uint8_t)file[reader.position + 4 + i] << (8 * i);
+    if (crc != bitwiseCrc32(out) || size != (uint32_t)out.size()) return std::nullopt;
+    return out;
+}
+
+uint32_t readBits(BitReader& reader, const int count) {
+    while (reader.bitCount < count) {
+        if (reader.position >= reader.bytes.size()) {
+            reader.failed = true;
+            return 0;
+        }
+        reader.bits |= (uint32_t)(uint8_t)reader.bytes[reader.position++] << reader.bitCount;
+        reader.bitCount += 8;
+    }
+    const auto value = count == 32 ? reader.bits : reader.bits & ((1u << count) - 1);
+    reader.bits = count == 32 ? 0 : reader.bits >> count;
+    reader.bitCount -= count;
+    return value;
+}
+
+InflateCode buildInflateCode(const uint8_t* lengths, const size_t count) {
+    InflateCode code;
+    for (size_t s = 0; s < count; s++) code.counts[lengths[s]]++;
+    code.counts[0] = 0;
+    for (uint8_t length = 1; length < 16; length++)
+        for (size_t s = 0; s < count; s++) if (lengths[s] == length) code.symbols.push_back((uint16_t)s);
+    return code;
+}
+
+//Codes of each length are consecutive numbers, so a code is found by reading
+//it a bit at a time, most significant first, and comparing against the first
+//code of its length. -1 for a code that is not in the table.
+int decodeSymbol(BitReader& reader, const InflateCode& code) {
+    int value = 0, first = 0, index = 0;
+    for (int length = 1; length < 16; length++) {
+        value |= (int)readBits(reader, 1);
+        if (reader.failed) return -1;
+        const int count = code.counts[length];
+        if (value - first < count) return code.symbols[index + value - first];
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+    return -1;
+}
+
+bool inflateCodes(BitReader& reader, const InflateCode& literalCode, const InflateCode& distanceCode,
+    std::vector<char>& out) {
+    static const std::array<uint16_t, 29> lengthStart{
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const std::array<uint8_t, 29> lengthBits{
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const std::array<uint16_t, 30> distanceStart{
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static const std::array<uint8_t, 30> distanceBits{
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+    while (true) {
+        const auto symbol = decodeSymbol(reader, literalCode);
+        if (symbol < 0 || symbol > 285) return false;
+        if (symbol < 256) {
+            out.push_back((char)symbol);
+            continue;
+        }
+        if (symbol == 256) return true;
+        const auto length = lengthStart[symbol - 257] + readBits(reader, lengthBits[symbol - 257]);
+        const auto d = decodeSymbol(reader, distanceCode);
+        if (d < 0 || d > 29) return false;
+        const size_t distance = distanceStart[d] + readBits(reader, distanceBits[d]);
+        if (reader.failed || distance > out.size()) return false;
+        //the copy may overlap the bytes it writes
+        for (uint32_t i = 0; i < length; i++) out.push_back(out[out.size() - distance]);
+    }
+}
+
+//a bit at a time, so it shares nothing with the table the exporter uses
+uint32_t bitwiseCrc32(const std::vector<char>& bytes) {
+    uint32_t crc = 0xffffffff;
+    for (const auto byte : bytes) {
+        crc ^= (uint8_t)byte;
+        for (int bit = 0; bit < 8; bit++) crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+    }
+    return ~crc;
+}
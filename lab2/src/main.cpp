@@ -26,8 +26,11 @@ bbenes@purdue.edu
 
 #include "triangle.h" //triangles
 #include "helper.h"         
-#include "objGen.h" //to save OBJ file format for 3D printing
+#include "meshExport.h" //to save OBJ, STL and PLY files for 3D printing in the background
+#include "exportFile.h" //the gzip round trip of --check
 #include "trackball.h"
+#include "meshBuilder.h" //the ruled surface, rebuilt per profile segment in the background
+#include "proceduralSurface.h" //the ruled surface, revolved in the vertex shader
 
 #pragma warning(disable : 4996)
 #pragma comment(lib, "glfw3.lib")
@@ -36,49 +39,27 @@ bbenes@purdue.edu
 TrackBallC trackball;
 bool mouseLeft, mouseMid, mouseRight;
 
-std::vector <TriangleC> tri;   //all the triangles will be stored here
 std::string filename = "geometry.obj";
+bool compressExport = false;//gzip the saved files
 
-GLuint points = 0; //number of points to display the object
 int steps = 12;//# of subdivisions
+bool exact = false;//one row per segment, steps from the chord error
+float chordError = 0.001f;//largest chord error relative to the radius in exact mode
+//how the surface is displayed: the mesh, revolved in the vertex shader, or ray marched
+enum DisplayMode { MESH_DISPLAY, GPU_REVOLUTION_DISPLAY, RAY_MARCH_DISPLAY };
+int displayMode = MESH_DISPLAY;
 int pointSize = 5;
 int lineWidth = 1;
 GLdouble mouseX, mouseY;
 
-//Vertex array object and vertex buffer object indices 
-GLuint visualizationVAO, visualizationVBO;
-
-
-inline void AddVertex(std::vector <GLfloat>* a, glm::vec3 A) {
-    a->push_back(A[0]); a->push_back(A[1]); a->push_back(A[2]);
-}
-
-
-auto P(const GLfloat u, const glm::vec2& p1, const glm::vec2& p2) {
-    return (p2[0] - p1[0]) / (p2[1] - p1[1]) * (u - p1[1]) + p1[0];
-}
-
-inline glm::vec3 S(const GLfloat u, const GLfloat v, const glm::vec2& p1, const glm::vec2& p2) {
-    return glm::vec3{ P(u, p1, p2) * sin(2 * M_PI * v), u, P(u, p1, p2) * cos(2 * M_PI * v) };
-}
-
-void createRuled(std::vector <GLfloat>* vv, const int step_count, const glm::vec2& p1, const glm::vec2& p2) {
-    const auto yMin = fminf(p1[1], p2[1]);
-    GLfloat iStep = abs(p1[1] - p2[1]) / step_count;
-    GLfloat jStep = 1.0f / step_count;
-    for (int i = 0; i < step_count; i++)
-        for (int j = 0; j < step_count; j++) {
-            //lower triangle
-            AddVertex(vv, S(yMin + i * iStep, j * jStep, p1, p2));
-            AddVertex(vv, S(yMin + (i + 1) * iStep, j * jStep, p1, p2));
-            AddVertex(vv, S(yMin + (i + 1) * iStep, (j + 1) * jStep, p1, p2));
-            //upper triangle
-            AddVertex(vv, S(yMin + i * iStep, j * jStep, p1, p2));
-            AddVertex(vv, S(yMin + (i + 1) * iStep, (j + 1) * jStep, p1, p2));
-            AddVertex(vv, S(yMin + i * iStep, (j + 1) * jStep, p1, p2));
-        }
-
-}
+//mesh of the ruled surface with its vertex array and buffers
+RuledMesh ruledMesh;
+//generates the ruled surface off the render thread
+MeshBuilder meshBuilder;
+//draws the ruled surface without a mesh
+ProceduralSurface proceduralSurface;
+//the running or last export
+MeshExport meshExport;
 
 
 int CompileShaders() {
@@ -127,39 +108,8 @@ int CompileShaders() {
     return shaderProg;
 }
 
-void buildScene(GLuint& VBO, GLuint& VAO, int step_count, std::vector<glm::vec2>& editorVertices) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    tri.clear();
-
-    if (editorVertices.size() <= 1) return;
-
-    std::vector<GLfloat> v{};
-    for (size_t i = 1; i < editorVertices.size(); ++i) {
-        createRuled(&v, step_count, editorVertices.at(i - 1), editorVertices.at(i));
-    }
-
-    //now get it ready for saving as OBJ
-    for (unsigned int i = 0; i < v.size(); i += 9) { //stride 3 - 3 vertices per triangle
-        TriangleC tmp;
-        glm::vec3 a, b, c;
-        a = glm::vec3(v[i], v[i + 1], v[i + 2]);
-        b = glm::vec3(v[i + 3], v[i + 4], v[i + 5]);
-        c = glm::vec3(v[i + 6], v[i + 7], v[i + 8]);
-        tmp.Set(a, b, c); //store them for 3D export
-        tri.push_back(tmp);
-    }
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    points = v.size();
-    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(GLfloat), &v[0], GL_STATIC_DRAW);
-
-    //Configure the attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    //Make it valid
-    glEnableVertexAttribArray(0);
+Tessellation currentTessellation() {
+    return exact ? exactTessellation(chordError) : Tessellation{ steps, steps };
 }
 
 //Quit when ESC is released
@@ -372,7 +322,17 @@ void editorMouseButtonCallback(GLFWwindow* window, int button, int action, int m
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmarkRevolution();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check") {
+        const auto watertight = checkWatertight();
+        const auto gzipRestored = checkGzipRoundTrip();
+        return watertight && gzipRestored ? 0 : 1;
+    }
+
     glfwInit();
 
     //negotiate with the OpenGL
@@ -401,7 +361,10 @@ int main() {
     std::vector<glm::vec2> editorVertices{};
     auto prevEditorVertices{ editorVertices };
     std::vector<GLfloat> editorVertexInsertionOrder{};
-    buildScene(visualizationVBO, visualizationVAO, steps, editorVertices);
+    initRuledMesh(ruledMesh);
+    startMeshBuilder(meshBuilder);
+    requestMesh(meshBuilder, currentTessellation(), editorVertices);
+    initProceduralSurface(proceduralSurface);
     int shaderProg = CompileShaders();
     GLint modelviewParameter = glGetUniformLocation(shaderProg, "modelview");
 
@@ -495,8 +458,7 @@ int main() {
         glfwMakeContextCurrent(window);
         ImGui::SetCurrentContext(windowGuiContext);
         glClear(GL_COLOR_BUFFER_BIT);
-        glBindVertexArray(visualizationVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, visualizationVBO);
+        glBindVertexArray(ruledMesh.VAO);
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -507,17 +469,71 @@ int main() {
         //checkbox to render or not the scene
         ImGui::Checkbox("Draw Scene", &drawScene);
         //checkbox to render or not the scene
-        if (ImGui::Button("Save OBJ")) SaveOBJ(&tri, filename);
-
         bool needRebuildScene{ false };
+        if (updateMeshExport(meshExport)) {
+            const auto& progress = meshExport.progress;
+            const auto throughput = std::to_string((int)(meshExportThroughput(meshExport) / 1e6)) + " MB/s";
+            ImGui::ProgressBar(progress.total > 0 ? (float)progress.done / progress.total : 0.0f, ImVec2(-1, 0), throughput.c_str());
+            if (ImGui::Button("Cancel")) cancelMeshExport(meshExport);
+        }
+        else {
+            const auto saveOBJ = ImGui::Button("Save OBJ");
+            ImGui::SameLine();
+            const auto saveSTL = ImGui::Button("Save STL");
+            ImGui::SameLine();
+            const auto savePLY = ImGui::Button("Save PLY");
+            ImGui::SameLine();
+            const auto saveGLB = ImGui::Button("Save GLB");
+            ImGui::SameLine();
+            ImGui::Checkbox("gzip", &compressExport);
+            if (saveOBJ || saveSTL || savePLY || saveGLB) {
+                //The displayed mesh is shared, not copied, and later edits copy it
+                //first. It is only used when it is the requested one, not a preview
+                //or the mesh from before an edit still being rebuilt.
+                const auto& front = frontMesh(meshBuilder);
+                const auto frontCurrent = displayMode == MESH_DISPLAY &&
+                    front.segments.size() + 1 == editorVertices.size() &&
+                    ruledGeometryWork(front, currentTessellation(), editorVertices) == 0;
+                std::function<std::shared_ptr<const Mesh>()> snapshot;
+                if (frontCurrent) {
+                    const std::shared_ptr<const Mesh> mesh = front.mesh;
+                    snapshot = [mesh]() { return mesh; };
+                }
+                else { //built on the export thread from the requested tessellation
+                    snapshot = [tessellation = currentTessellation(), editorVertices]() {
+                        RuledGeometry geometry;
+                        updateRuledGeometry(geometry, tessellation, editorVertices);
+                        return std::shared_ptr<const Mesh>(geometry.mesh);
+                    };
+                }
+                const std::string suffix = compressExport ? ".gz" : "";
+                if (saveOBJ) startMeshExport(meshExport, OBJ_EXPORT, filename + suffix, snapshot);
+                if (saveSTL) startMeshExport(meshExport, STL_EXPORT, "geometry.stl" + suffix, snapshot);
+                if (savePLY) startMeshExport(meshExport, PLY_EXPORT, "geometry.ply" + suffix, snapshot);
+                if (saveGLB) startMeshExport(meshExport, GLB_EXPORT, "geometry.glb" + suffix, snapshot);
+            }
+            if (!meshExport.status.empty()) ImGui::Text("%s", meshExport.status.c_str());
+        }
+        if (ImGui::Combo("Display", &displayMode, "Mesh\0GPU Revolution\0Ray March\0")) needRebuildScene = true;
+
         if (prevEditorVertices != editorVertices) {
             needRebuildScene = true;
             prevEditorVertices = editorVertices;
+            //only a few floats, so it is always kept current
+            updateProceduralProfile(proceduralSurface, editorVertices);
+        }
+        if (ImGui::Checkbox("Exact Tessellation", &exact)) needRebuildScene = true;
+        if (exact) {
+            if (ImGui::SliderFloat("Chord Error", &chordError, 0.0001f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic)) needRebuildScene = true;
+            ImGui::Text("%d steps around the axis", currentTessellation().steps);
         }
-        if (ImGui::SliderInt("Mesh Subdivision", &steps, 1, 100, "%d", 0) || needRebuildScene) {
-            buildScene(visualizationVBO, visualizationVAO, steps, editorVertices);
+        else if (ImGui::SliderInt("Mesh Subdivision", &steps, 1, 100, "%d", 0)) needRebuildScene = true;
+        if (needRebuildScene) {
+            if (displayMode == MESH_DISPLAY) requestMesh(meshBuilder, currentTessellation(), editorVertices);
             needRebuildScene = false;
         }
+        //only the newest finished mesh is uploaded
+        if (const auto geometry = takeMesh(meshBuilder)) uploadRuledMesh(ruledMesh, *geometry);
         if (ImGui::SliderInt("point Size", &pointSize, 1, 10, "%d", 0)) {
             glPointSize(pointSize); //set the new point size if it has been changed			
         }
@@ -547,9 +563,16 @@ int main() {
         //and send it to the vertex shader
         glUniformMatrix4fv(modelviewParameter, 1, GL_FALSE, glm::value_ptr(modelView));
 
-        if (drawScene) {
-            glDrawArrays(GL_POINTS, 0, points / 3);
-            glDrawArrays(GL_TRIANGLES, 0, points / 3);
+        if (drawScene && displayMode == GPU_REVOLUTION_DISPLAY) {
+            drawProceduralSurface(proceduralSurface, currentTessellation(), modelView, color);
+        }
+        else if (drawScene && displayMode == RAY_MARCH_DISPLAY) {
+            drawRayMarchedSurface(proceduralSurface, modelView, color);
+        }
+        else if (drawScene) {
+            glBindVertexArray(ruledMesh.VAO);
+            glDrawArrays(GL_POINTS, 0, ruledMeshVertexCount(ruledMesh));
+            glDrawElements(GL_TRIANGLES, ruledMeshIndexCount(ruledMesh), GL_UNSIGNED_INT, (void*)0);
         }
 
         // Renders the ImGUI elements
@@ -574,8 +597,10 @@ int main() {
         glfwPollEvents();
     }
     //Cleanup
-    glDeleteVertexArrays(1, &visualizationVAO);
-    glDeleteBuffers(1, &visualizationVBO);
+    stopMeshExport(meshExport);
+    stopMeshBuilder(meshBuilder);
+    deleteProceduralSurface(proceduralSurface);
+    deleteRuledMesh(ruledMesh);
     glDeleteProgram(shaderProg);
     glfwDestroyWindow(window);
     glfwDestroyWindow(editorWindow);
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "mesh.h"
+
+//bit pattern of a position, with -0 folded into +0
+typedef std::array<uint32_t, 3> PositionKey;
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for (const auto k : key) h = (h ^ k) * 0x100000001b3ull;
+        return (size_t)(h ^ (h >> 32));
+    }
+};
+
+Mesh weldMesh(const Mesh& mesh, ExportProgress* progress) {
+    Mesh welded;
+    std::vector<GLuint> remap(meshVertexCount(mesh));
+    std::unordered_map<PositionKey, GLuint, PositionKeyHash> unique{};
+    unique.reserve(remap.size());
+    welded.positions.reserve(mesh.positions.size());
+    for (size_t v = 0; v < remap.size(); v++) {
+        if (progress != nullptr && (v & 0xffff) == 0) {
+            if (progress->cancelled) return Mesh{};
+            progress->done += std::min<size_t>(0x10000, remap.size() - v);
+        }
+        PositionKey key{};
+        for (int c = 0; c < 3; c++) {
+            const GLfloat value = mesh.positions[3 * v + c] + 0.0f;
+            std::memcpy(&key[c], &value, sizeof(value));
+        }
+        const auto [it, inserted] = unique.emplace(key, (GLuint)meshVertexCount(welded));
+        if (inserted) welded.positions.insert(welded.positions.end(), &mesh.positions[3 * v], &mesh.positions[3 * v] + 3);
+        remap[v] = it->second;
+    }
+
+    welded.indices.reserve(mesh.indices.size());
+    for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+        const auto a = remap[mesh.indices[t]], b = remap[mesh.indices[t + 1]], c = remap[mesh.indices[t + 2]];
+        if (a == b || b == c || c == a) continue;
+        welded.indices.insert(welded.indices.end(), { a, b, c });
+    }
+    return welded;
+}
+
+size_t openEdgeCount(const Mesh& mesh) {
+    std::unordered_map<uint64_t, uint32_t> triangles{};
+    triangles.reserve(mesh.indices.size());
+    for (size_t t = 0; t < mesh.indices.size(); t += 3)
+        for (size_t c = 0; c < 3; c++) {
+            const uint64_t a = mesh.indices[t + c], b = mesh.indices[t + (c + 1) % 3];
+            triangles[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    return std::count_if(triangles.begin(), triangles.end(), [](const auto& edge) { return edge.second != 2; });
+}
+
+const std::optional<Mesh> startExport(const Mesh& mesh, ExportProgress* progress) {
+    if (progress == nullptr) return weldMesh(mesh);
+    //welding, then writing at most as many vertices and faces as there are now
+    progress->total = 2 * meshVertexCount(mesh) + meshTriangleCount(mesh);
+    auto welded = weldMesh(mesh, progress);
+    if (progress->cancelled) return std::nullopt;
+    progress->done = meshVertexCount(mesh);
+    progress->total = meshVertexCount(mesh) + meshVertexCount(welded) + meshTriangleCount(welded);
+    return welded;
+}
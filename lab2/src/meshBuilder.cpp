@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "meshBuilder.h"
+
+//step counts of the coarse previews
+const std::array<int, 3> previewSteps{ 4, 16, 64 };
+//requests writing fewer values than this skip the previews
+const size_t minPreviewWork = 1 << 21;
+
+void buildMeshes(MeshBuilder& builder);
+int backGeometry(const MeshBuilder& builder, const Tessellation& tessellation, const Tessellation& finalTessellation);
+
+void startMeshBuilder(MeshBuilder& builder) {
+    builder.thread = std::thread(buildMeshes, std::ref(builder));
+}
+
+void requestMesh(MeshBuilder& builder, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices) {
+    {
+        std::lock_guard lock(builder.mutex);
+        builder.tessellation = tessellation;
+        builder.editorVertices = editorVertices;
+        builder.requested++;
+    }
+    builder.wake.notify_one();
+}
+
+const RuledGeometry* takeMesh(MeshBuilder& builder) {
+    std::unique_lock lock(builder.mutex);
+    if (builder.ready < 0) return nullptr;
+    builder.front = builder.ready;
+    builder.ready = -1;
+    lock.unlock();
+    //the worker may be waiting for its preview to be shown
+    builder.wake.notify_one();
+    return &builder.geometries[builder.front];
+}
+
+void stopMeshBuilder(MeshBuilder& builder) {
+    {
+        std::lock_guard lock(builder.mutex);
+        builder.quit = true;
+        builder.requested++; //abandons the mesh being built
+    }
+    builder.wake.notify_one();
+    if (builder.thread.joinable()) builder.thread.join();
+}
+
+void buildMeshes(MeshBuilder& builder) {
+    uint64_t built = 0;
+    std::unique_lock lock(builder.mutex);
+    while (true) {
+        builder.wake.wait(lock, [&] { return builder.quit || builder.requested != built; });
+        if (builder.quit) return;
+
+        const uint64_t job = built = builder.requested;
+        const auto tessellation = builder.tessellation;
+        const auto editorVertices = builder.editorVertices;
+        const auto superseded = [&] { return builder.requested != job; };
+
+        //the mesh on screen may be the closest one to the request
+        const auto work = [&](int i) { return ruledGeometryWork(builder.geometries[i], tessellation, editorVertices); };
+        std::vector<Tessellation> levels{};
+        if (std::min(work(builder.front), work(backGeometry(builder, tessellation, tessellation))) >= minPreviewWork)
+            for (const auto s : previewSteps)
+                if (s < tessellation.steps) levels.push_back(Tessellation{ std::min(s, tessellation.rows), s });
+        levels.push_back(tessellation);
+
+        for (const auto level : levels) {
+            if (superseded()) break;
+            //an unclaimed mesh is out of date now, so its buffer may be reused
+            builder.ready = -1;
+            const auto back = backGeometry(builder, level, tessellation);
+            //copying a value costs about a tenth of generating it, so the mesh on
+            //screen is copied when it saves enough regeneration; the update makes
+            //the copy, since the mesh is then shared;
+            //nothing writes the front geometry, so it is read without the lock
+            const auto& front = builder.geometries[builder.front];
+            const auto frontSize = front.mesh->positions.size() + front.mesh->indices.size();
+            const auto copyFront = level == tessellation && work(back) > work(builder.front) + frontSize / 10;
+            lock.unlock();
+            if (copyFront) builder.geometries[back] = front;
+            const auto finished = updateRuledGeometry(builder.geometries[back], level, editorVertices, superseded);
+            lock.lock();
+            if (!finished || superseded()) break;
+            builder.ready = back;
+
+            //let the preview reach the screen before refining it
+            if (level != tessellation)
+                builder.wake.wait(lock, [&] { return builder.quit || superseded() || builder.ready < 0; });
+        }
+    }
+}
+
+//Picks a geometry the render thread is not reading: the one already at
+//tessellation if any, otherwise one not holding the final tessellation.
+int backGeometry(const MeshBuilder& builder, const Tessellation& tessellation, const Tessellation& finalTessellation) {
+    int back = -1;
+    for (int i = 0; i < (int)builder.geometries.size(); i++) {
+        if (i == builder.front) continue;
+        const auto& current = builder.geometries[i].tessellation;
+        if (current == tessellation) return i;
+        if (back < 0 || current != finalTessellation) back = i;
+    }
+    return back;
+}
@@ -0,0 +1,57 @@
+#include "meshExport.h"
+#include "glbGen.h"
+#include "objGen.h"
+#include "plyGen.h"
+#include "stlGen.h"
+
+void startMeshExport(MeshExport& meshExport, const ExportFormat format, const std::string& filename,
+    const std::function<std::shared_ptr<const Mesh>()>& snapshot) {
+    if (updateMeshExport(meshExport)) return;
+
+    meshExport.progress.done = 0;
+    meshExport.progress.total = 0;
+    meshExport.progress.bytes = 0;
+    meshExport.progress.cancelled = false;
+    meshExport.progress.failed = false;
+    meshExport.filename = filename;
+    meshExport.start = std::chrono::steady_clock::now();
+    meshExport.status.clear();
+    meshExport.running = true;
+    meshExport.thread = std::thread([&meshExport, format, filename, snapshot]() {
+        const auto mesh = snapshot();
+        if (!meshExport.progress.cancelled) {
+            if (format == OBJ_EXPORT) SaveOBJ(*mesh, filename, &meshExport.progress);
+            if (format == STL_EXPORT) SaveSTL(*mesh, filename, &meshExport.progress);
+            if (format == PLY_EXPORT) SavePLY(*mesh, filename, &meshExport.progress);
+            if (format == GLB_EXPORT) SaveGLB(*mesh, filename, &meshExport.progress);
+        }
+        meshExport.running = false;
+    });
+}
+
+void cancelMeshExport(MeshExport& meshExport) {
+    meshExport.progress.cancelled = true;
+}
+
+bool updateMeshExport(MeshExport& meshExport) {
+    if (meshExport.running) return true;
+    if (!meshExport.thread.joinable()) return false;
+
+    meshExport.thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - meshExport.start;
+    if (meshExport.progress.failed) meshExport.status = "Failed to save " + meshExport.filename;
+    else if (meshExport.progress.cancelled) meshExport.status = "Cancelled " + meshExport.filename;
+    else meshExport.status = "Saved " + meshExport.filename + " in " + std::to_string((int)(elapsed.count() * 1000)) + " ms";
+    return false;
+}
+
+void stopMeshExport(MeshExport& meshExport) {
+    cancelMeshExport(meshExport);
+    if (meshExport.thread.joinable()) meshExport.thread.join();
+    meshExport.running = false;
+}
+
+double meshExportThroughput(const MeshExport& meshExport) {
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - meshExport.start;
+    return elapsed.count() > 0 ? meshExport.progress.bytes / elapsed.count() : 0;
+}
@@ -1,35 +1,87 @@
+#include <algorithm>
+#include <charconv>
 #include <fstream> 
+#include <functional>
+#include <thread>
 #include <vector> 
 #include <memory.h>
 #include <math.h>
-#include "triangle.h"
+#include "exportFile.h"
 #include "objGen.h"
 
 
 using namespace std;
 
-void SaveOBJ(std::vector <TriangleC> *v, std::string filename) {
+//longest line either section writes, "v" with three floats or "f" with three indices
+const size_t maxLineLength = 64;
+//lines formatted by one thread at a time
+const size_t chunkLines = 1 << 16;
 
-	ofstream myfile;
-	myfile.open(filename);
+void WriteLines(ExportFile& file, const size_t count, const std::function<char* (size_t, char*)>& formatLine, ExportProgress* progress);
 
-	myfile << "# Generated by Bedrich Benes bbenes@purdue.edu\n";
-	myfile << "# vertices\n";
-	for (unsigned int i = 0; i < v->size(); i++) {
-		myfile << "v " << v->at(i).a.z << " " << v->at(i).a.y << " " << v->at(i).a.x << "\n";
-		myfile << "v " << v->at(i).b.z << " " << v->at(i).b.y << " " << v->at(i).b.x << "\n";
-		myfile << "v " << v->at(i).c.z << " " << v->at(i).c.y << " " << v->at(i).c.x << "\n";
-	}
-	int counter = 1;
-	myfile << "# faces\n";
-	for (unsigned int i = 0; i < v->size(); i++) {
-		myfile << "f " << counter++;
-		myfile << " " << counter++;
-		myfile << " " << counter++ << " " << "\n";
-	}
-	myfile.close();
+void SaveOBJ(const Mesh& mesh, std::string filename, ExportProgress* progress) {
+	//shared vertices are written once and referenced by the faces
+	const auto exported = startExport(mesh, progress);
+	if (!exported) return;
+	const auto& welded = *exported;
 
-}
+	ExportFile myfile;
+	if (!openExportFile(myfile, filename, progress, true)) return;
+
+	//precision 6 in general format is what operator<< writes
+	const auto writeFloat = [](char* out, GLfloat value) { return std::to_chars(out, out + 16, value, std::chars_format::general, 6).ptr; };
+	const auto writeIndex = [](char* out, GLuint value) { return std::to_chars(out, out + 16, value).ptr; };
 
+	writeExportFile(myfile, "# Generated by Bedrich Benes bbenes@purdue.edu\n");
+	writeExportFile(myfile, "# vertices\n");
+	WriteLines(myfile, meshVertexCount(welded), [&](size_t i, char* out) {
+		const auto p = &welded.positions[3 * i];
+		*out++ = 'v';
+		for (size_t c = 0; c < 3; c++) {
+			*out++ = ' ';
+			out = writeFloat(out, p[c]);
+		}
+		*out++ = '\n';
+		return out;
+	}, progress);
+	writeExportFile(myfile, "# faces\n");
+	WriteLines(myfile, meshTriangleCount(welded), [&](size_t i, char* out) {
+		*out++ = 'f';
+		for (size_t c = 0; c < 3; c++) {
+			*out++ = ' ';
+			out = writeIndex(out, welded.indices[3 * i + c] + 1); //OBJ indices start at 1
+		}
+		*out++ = ' ';
+		*out++ = '\n';
+		return out;
+	}, progress);
+	finishExportFile(myfile, filename, progress);
 
+}
+
+//Formats the lines in chunks, one chunk per thread, then writes the chunks in
+//order. Only one round of chunks is held in memory at a time.
+void WriteLines(ExportFile& file, const size_t count, const std::function<char* (size_t, char*)>& formatLine, ExportProgress* progress) {
+	const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::vector<char>> chunks(threadCount, std::vector<char>(chunkLines * maxLineLength));
+	std::vector<size_t> sizes(threadCount);
+	const auto format = [&](size_t chunk, size_t first) {
+		auto out = chunks[chunk].data();
+		for (size_t i = first; i < std::min(first + chunkLines, count); i++) out = formatLine(i, out);
+		sizes[chunk] = out - chunks[chunk].data();
+	};
 
+	for (size_t round = 0; round < count; round += threadCount * chunkLines) {
+		if (progress != nullptr && progress->cancelled) return;
+		const auto roundChunks = std::min(threadCount, (count - round + chunkLines - 1) / chunkLines);
+		{
+			std::vector<std::jthread> threads{};
+			for (size_t chunk = 1; chunk < roundChunks; chunk++) threads.emplace_back(format, chunk, round + chunk * chunkLines);
+			format(0, round);
+		}
+		for (size_t chunk = 0; chunk < roundChunks; chunk++) writeExportFile(file, chunks[chunk].data(), sizes[chunk]);
+		if (progress == nullptr) continue;
+		progress->done += std::min(threadCount * chunkLines, count - round);
+		for (size_t chunk = 0; chunk < roundChunks; chunk++) progress->bytes += sizes[chunk];
+	}
+}
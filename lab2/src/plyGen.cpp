@@ -1,42 +1,59 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <fstream> 
 #include <vector> 
-#include <GL/freeglut.h>
-#include <memory.h>
-#include <math.h>
-#include "math/vect3d.h"
-#include "math/triangle.h"
+#include "exportFile.h"
 #include "plyGen.h"
 
 
 using namespace std;
 
-void SavePLY(std::vector <TriangleC> *v, char *filename) {
-
-	ofstream myfile;
-	myfile.open(filename);
-
-	myfile << "ply\n";
-	myfile << "format ascii 1.0\n";
-	myfile << "comment made by Bedrich Benes bbenes@purdue.edu\n";
-	myfile << "element vertex " << v->size() * 3 << "\n"; //put the number here
-	myfile << "property float x\n";
-	myfile << "property float y\n";
-	myfile << "property float z\n";
-	myfile << "element face " << v->size() << "\n";
-	myfile << "property list uint8 int32 vertex_index\n";
-	myfile << "end_header\n";
-	for (unsigned int i = 0; i < v->size(); i++) {
-		myfile << v->at(i).a.GetX() << " " << v->at(i).a.GetY() << " " << v->at(i).a.GetZ() << "\n";
-		myfile << v->at(i).b.GetX() << " " << v->at(i).b.GetY() << " " << v->at(i).b.GetZ() << "\n";
-		myfile << v->at(i).c.GetX() << " " << v->at(i).c.GetY() << " " << v->at(i).c.GetZ() << "\n";
+//Binary little-endian PLY with welded vertices: float xyz per vertex and a
+//uint8 count followed by three uint32 indices per face.
+void SavePLY(const Mesh& mesh, std::string filename, ExportProgress* progress) {
+	static_assert(std::endian::native == std::endian::little, "the PLY is written in the native byte order");
+	const auto exported = startExport(mesh, progress);
+	if (!exported) return;
+	const auto& welded = *exported;
+
+	ExportFile myfile;
+	if (!openExportFile(myfile, filename, progress)) return;
+
+	writeExportFile(myfile, "ply\n");
+	writeExportFile(myfile, "format binary_little_endian 1.0\n");
+	writeExportFile(myfile, "comment made by Bedrich Benes bbenes@purdue.edu\n");
+	writeExportFile(myfile, "element vertex " + to_string(meshVertexCount(welded)) + "\n");
+	writeExportFile(myfile, "property float x\n");
+	writeExportFile(myfile, "property float y\n");
+	writeExportFile(myfile, "property float z\n");
+	writeExportFile(myfile, "element face " + to_string(meshTriangleCount(welded)) + "\n");
+	writeExportFile(myfile, "property list uchar uint vertex_indices\n");
+	writeExportFile(myfile, "end_header\n");
+	writeExportFile(myfile, (const char*)welded.positions.data(), welded.positions.size() * sizeof(GLfloat));
+	if (progress != nullptr) {
+		progress->done += meshVertexCount(welded);
+		progress->bytes += welded.positions.size() * sizeof(GLfloat);
 	}
-	int counter = 0;
-	for (unsigned int i = 0; i < v->size(); i++) {
-		myfile << "3 " << counter++ << " " << counter++ << " " << counter++ << " " << "\n";
+
+	//13 bytes per face, written a block of faces at a time
+	const size_t faceSize = 1 + 3 * sizeof(uint32_t);
+	const size_t blockFaces = 1 << 16;
+	std::vector<char> block(blockFaces * faceSize);
+	for (size_t first = 0; first < meshTriangleCount(welded); first += blockFaces) {
+		if (progress != nullptr && progress->cancelled) break;
+		const auto count = std::min(blockFaces, meshTriangleCount(welded) - first);
+		for (size_t i = 0; i < count; i++) {
+			block[i * faceSize] = 3;
+			std::memcpy(&block[i * faceSize + 1], &welded.indices[3 * (first + i)], 3 * sizeof(uint32_t));
+		}
+		writeExportFile(myfile, block.data(), count * faceSize);
+		if (progress != nullptr) {
+			progress->done += count;
+			progress->bytes += count * faceSize;
+		}
 	}
-	myfile.close();
+	finishExportFile(myfile, filename, progress);
 
 }
-
-
-
@@ -0,0 +1,221 @@
+#include <algorithm>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "proceduralSurface.h"
+
+GLuint linkProgram(const char* vsSrc, const char* fsSrc);
+
+void initProceduralSurface(ProceduralSurface& surface) {
+    //Vertex Shader, the same lattice and triangles createRuled() makes
+    const char* vsSrc = "#version 330 core\n"
+        "uniform samplerBuffer profile;\n"
+        "uniform int rows;\n"
+        "uniform int steps;\n"
+        "uniform bool triangles;\n"
+        "uniform mat4 modelview;\n"
+        "const ivec2 corners[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1), ivec2(0, 0), ivec2(1, 1), ivec2(0, 1));\n"
+        "void main()\n"
+        "{\n"
+        "   int segment, i, j;\n"
+        "   if (triangles) {\n"
+        "       int quad = gl_VertexID / 6;\n"
+        "       segment = quad / (rows * steps);\n"
+        "       ivec2 corner = corners[gl_VertexID % 6];\n"
+        "       i = quad % (rows * steps) / steps + corner.x;\n"
+        "       j = (quad % steps + corner.y) % steps;\n"
+        "   } else {\n"
+        "       int lattice = (rows + 1) * steps;\n"
+        "       segment = gl_VertexID / lattice;\n"
+        "       i = gl_VertexID % lattice / steps;\n"
+        "       j = gl_VertexID % steps;\n"
+        "   }\n"
+        "   vec2 p1 = texelFetch(profile, segment).xy;\n"
+        "   vec2 p2 = texelFetch(profile, segment + 1).xy;\n"
+        "   float u = min(p1.y, p2.y) + i * abs(p1.y - p2.y) / rows;\n"
+        "   float r = (p2.x - p1.x) / (p2.y - p1.y) * (u - p1.y) + p1.x;\n"
+        "   float angle = 6.28318530718 * j / steps;\n"
+        "   gl_Position = modelview * vec4(r * sin(angle), u, r * cos(angle), 1.0);\n"
+        "}\0";
+
+    //Fragment Shader
+    const char* fsSrc = "#version 330 core\n"
+        "out vec4 col;\n"
+        "uniform vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "   col = color;\n"
+        "}\n\0";
+
+    surface.program = linkProgram(vsSrc, fsSrc);
+
+    //one triangle covering the screen
+    const char* rayVsSrc = "#version 330 core\n"
+        "void main()\n"
+        "{\n"
+        "   gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);\n"
+        "}\0";
+
+    //Sphere tracing. The surface is the profile revolved around the y axis, so
+    //the distance to it is the 2D distance from (radius, height) to the profile.
+    const char* rayFsSrc = "#version 330 core\n"
+        "out vec4 col;\n"
+        "uniform samplerBuffer profile;\n"
+        "uniform int segments;\n"
+        "uniform float boundingRadius;\n"
+        "uniform mat4 inverseModelview;\n"
+        "uniform vec4 viewport;\n"
+        "uniform vec4 color;\n"
+        "float segmentDistance(vec2 q, vec2 a, vec2 b)\n"
+        "{\n"
+        "   vec2 ab = b - a;\n"
+        "   float h = clamp(dot(q - a, ab) / max(dot(ab, ab), 1e-12), 0.0, 1.0);\n"
+        "   return length(q - a - h * ab);\n"
+        "}\n"
+        "float surfaceDistance(vec3 p)\n"
+        "{\n"
+        "   vec2 q = vec2(length(p.xz), p.y);\n"
+        "   float d = 1e9;\n"
+        "   for (int k = 0; k < segments; k++) {\n"
+        "       vec2 a = texelFetch(profile, k).xy;\n"
+        "       vec2 b = texelFetch(profile, k + 1).xy;\n"
+        "       //a negative radius revolves into the same circle as its mirror\n"
+        "       d = min(d, min(segmentDistance(q, a, b), segmentDistance(vec2(-q.x, q.y), a, b)));\n"
+        "   }\n"
+        "   return d;\n"
+        "}\n"
+        "vec3 unproject(vec3 ndc)\n"
+        "{\n"
+        "   vec4 p = inverseModelview * vec4(ndc, 1.0);\n"
+        "   return p.xyz / p.w;\n"
+        "}\n"
+        "void main()\n"
+        "{\n"
+        "   vec2 ndc = (gl_FragCoord.xy - viewport.xy) / viewport.zw * 2.0 - 1.0;\n"
+        "   vec3 origin = unproject(vec3(ndc, -1.0));\n"
+        "   vec3 direction = normalize(unproject(vec3(ndc, 0.0)) - origin);\n"
+        "   //a hit is close enough once it is within half a pixel\n"
+        "   vec3 nextOrigin = unproject(vec3(ndc.x + 2.0 / viewport.z, ndc.y, -1.0));\n"
+        "   float pixelAngle = length(normalize(unproject(vec3(ndc.x + 2.0 / viewport.z, ndc.y, 0.0)) - nextOrigin) - direction);\n"
+        "   //only march through the sphere holding the surface\n"
+        "   float b = dot(origin, direction);\n"
+        "   float disc = b * b - dot(origin, origin) + boundingRadius * boundingRadius;\n"
+        "   if (disc < 0.0) discard;\n"
+        "   float t = max(-b - sqrt(disc), 0.0);\n"
+        "   float tEnd = -b + sqrt(disc);\n"
+        "   for (int i = 0; i < 256 && t < tEnd; i++) {\n"
+        "       vec3 p = origin + t * direction;\n"
+        "       float d = surfaceDistance(p);\n"
+        "       if (d < max(0.5 * t * pixelAngle, 1e-5)) {\n"
+        "           const vec2 e = vec2(1e-3, 0.0);\n"
+        "           vec3 n = normalize(vec3(surfaceDistance(p + e.xyy) - surfaceDistance(p - e.xyy),\n"
+        "               surfaceDistance(p + e.yxy) - surfaceDistance(p - e.yxy),\n"
+        "               surfaceDistance(p + e.yyx) - surfaceDistance(p - e.yyx)));\n"
+        "           col = vec4(color.rgb * (0.25 + 0.75 * abs(dot(n, direction))), color.a);\n"
+        "           return;\n"
+        "       }\n"
+        "       t += d;\n"
+        "   }\n"
+        "   discard;\n"
+        "}\n\0";
+    surface.rayMarchProgram = linkProgram(rayVsSrc, rayFsSrc);
+
+    surface.modelviewParameter = glGetUniformLocation(surface.program, "modelview");
+    surface.colorParameter = glGetUniformLocation(surface.program, "color");
+    surface.rowsParameter = glGetUniformLocation(surface.program, "rows");
+    surface.stepsParameter = glGetUniformLocation(surface.program, "steps");
+    surface.trianglesParameter = glGetUniformLocation(surface.program, "triangles");
+
+    glGenVertexArrays(1, &surface.VAO);
+    glGenBuffers(1, &surface.profileBuffer);
+    glGenTextures(1, &surface.profileTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, surface.profileBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec2), nullptr, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, surface.profileTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, surface.profileBuffer);
+}
+
+void updateProceduralProfile(ProceduralSurface& surface, const std::vector<glm::vec2>& editorVertices) {
+    surface.segmentCount = editorVertices.size() > 1 ? (GLsizei)editorVertices.size() - 1 : 0;
+    //every revolved point is as far from the origin as its profile point
+    surface.boundingRadius = 0;
+    for (const auto& p : editorVertices) surface.boundingRadius = std::max(surface.boundingRadius, glm::length(p));
+    surface.boundingRadius += 0.01f;
+    if (editorVertices.empty()) return;
+    //glm::vec2 is two tightly packed floats, one RG32F texel
+    glBindBuffer(GL_TEXTURE_BUFFER, surface.profileBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, editorVertices.size() * sizeof(glm::vec2), editorVertices.data(), GL_DYNAMIC_DRAW);
+}
+
+void drawProceduralSurface(const ProceduralSurface& surface, const Tessellation& tessellation, const glm::mat4& modelView, const float color[4]) {
+    if (surface.segmentCount == 0) return;
+
+    GLint previousProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glUseProgram(surface.program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, surface.profileTexture);
+    glUniform1i(glGetUniformLocation(surface.program, "profile"), 0);
+    glUniformMatrix4fv(surface.modelviewParameter, 1, GL_FALSE, glm::value_ptr(modelView));
+    glUniform4f(surface.colorParameter, color[0], color[1], color[2], color[3]);
+    glUniform1i(surface.rowsParameter, tessellation.rows);
+    glUniform1i(surface.stepsParameter, tessellation.steps);
+
+    glBindVertexArray(surface.VAO);
+    glUniform1i(surface.trianglesParameter, GL_FALSE);
+    glDrawArrays(GL_POINTS, 0, surface.segmentCount * (GLsizei)segmentVertexCount(tessellation));
+    glUniform1i(surface.trianglesParameter, GL_TRUE);
+    glDrawArrays(GL_TRIANGLES, 0, surface.segmentCount * 6 * tessellation.rows * tessellation.steps);
+    glUseProgram(previousProgram);
+}
+
+void drawRayMarchedSurface(const ProceduralSurface& surface, const glm::mat4& modelView, const float color[4]) {
+    if (surface.segmentCount == 0) return;
+
+    GLint previousProgram = 0, viewport[4] = {}, polygonMode[2] = {};
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+    const auto program = surface.rayMarchProgram;
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, surface.profileTexture);
+    glUniform1i(glGetUniformLocation(program, "profile"), 0);
+    glUniform1i(glGetUniformLocation(program, "segments"), surface.segmentCount);
+    glUniform1f(glGetUniformLocation(program, "boundingRadius"), surface.boundingRadius);
+    glUniformMatrix4fv(glGetUniformLocation(program, "inverseModelview"), 1, GL_FALSE, glm::value_ptr(glm::inverse(modelView)));
+    glUniform4f(glGetUniformLocation(program, "viewport"), (float)viewport[0], (float)viewport[1], (float)viewport[2], (float)viewport[3]);
+    glUniform4f(glGetUniformLocation(program, "color"), color[0], color[1], color[2], color[3]);
+
+    //the scene is drawn as wireframe, which would leave only the triangle's edges
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(surface.VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+    glUseProgram(previousProgram);
+}
+
+void deleteProceduralSurface(ProceduralSurface& surface) {
+    glDeleteProgram(surface.program);
+    glDeleteProgram(surface.rayMarchProgram);
+    glDeleteVertexArrays(1, &surface.VAO);
+    glDeleteBuffers(1, &surface.profileBuffer);
+    glDeleteTextures(1, &surface.profileTexture);
+    surface = ProceduralSurface{};
+}
+
+GLuint linkProgram(const char* vsSrc, const char* fsSrc) {
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vsSrc, NULL);
+    glCompileShader(vs);
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &fsSrc, NULL);
+    glCompileShader(fs);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return program;
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#define REVOLUTION_SSE
+#include <immintrin.h>
+#endif
+
+#include "revolution.h"
+
+AngularRing createAngularRing(const int step_count) {
+    AngularRing ring;
+    ring.steps = step_count;
+    ring.sines.resize(step_count);
+    ring.cosines.resize(step_count);
+    for (int j = 0; j < step_count; j++) {
+        const auto angle = 2 * M_PI * j / step_count;
+        ring.sines[j] = (GLfloat)sin(angle);
+        ring.cosines[j] = (GLfloat)cos(angle);
+    }
+    return ring;
+}
+
+Tessellation exactTessellation(const float chordError) {
+    const auto steps = (int)ceil(M_PI / acos(1 - std::clamp(chordError, 1e-6f, 1.0f)));
+    return Tessellation{ 1, std::max(steps, 3) };
+}
+
+void profileRadii(const GLfloat* us, GLfloat* radii, const size_t count, const glm::vec2& p1, const glm::vec2& p2) {
+    const auto slope = (p2[0] - p1[0]) / (p2[1] - p1[1]);
+    size_t i = 0;
+#ifdef __AVX2__
+    {
+        const auto slope8 = _mm256_set1_ps(slope);
+        const auto y8 = _mm256_set1_ps(p1[1]);
+        const auto x8 = _mm256_set1_ps(p1[0]);
+        for (; i + 8 <= count; i += 8) {
+            const auto u = _mm256_loadu_ps(us + i);
+            _mm256_storeu_ps(radii + i, _mm256_add_ps(_mm256_mul_ps(slope8, _mm256_sub_ps(u, y8)), x8));
+        }
+    }
+#endif
+#ifdef REVOLUTION_SSE
+    {
+        const auto slope4 = _mm_set1_ps(slope);
+        const auto y4 = _mm_set1_ps(p1[1]);
+        const auto x4 = _mm_set1_ps(p1[0]);
+        for (; i + 4 <= count; i += 4) {
+            const auto u = _mm_loadu_ps(us + i);
+            _mm_storeu_ps(radii + i, _mm_add_ps(_mm_mul_ps(slope4, _mm_sub_ps(u, y4)), x4));
+        }
+    }
+#endif
+    for (; i < count; i++) radii[i] = slope * (us[i] - p1[1]) + p1[0];
+}
+
+void revolveSegment(GLfloat* out, const AngularRing& ring, const int row_count, const glm::vec2& p1, const glm::vec2& p2) {
+    const auto step_count = ring.steps;
+    const auto yMin = fminf(p1[1], p2[1]);
+    const GLfloat iStep = abs(p1[1] - p2[1]) / row_count;
+
+    std::vector<GLfloat> us(row_count + 1), radii(row_count + 1);
+    for (int i = 0; i <= row_count; i++) us[i] = yMin + i * iStep;
+    profileRadii(us.data(), radii.data(), us.size(), p1, p2);
+    //the end rows are the profile points themselves, so neighboring segments
+    //write bit-identical rings that the exporters weld
+    const auto& bottom = p1[1] <= p2[1] ? p1 : p2;
+    const auto& top = p1[1] <= p2[1] ? p2 : p1;
+    us[0] = bottom[1];
+    radii[0] = bottom[0];
+    us[row_count] = top[1];
+    radii[row_count] = top[0];
+
+    //no trigonometry is left per vertex, only two multiplications
+    for (int i = 0; i <= row_count; i++) {
+        const auto u = us[i];
+        const auto r = radii[i];
+        for (int j = 0; j < step_count; j++) {
+            *out++ = r * ring.sines[j];
+            *out++ = u;
+            *out++ = r * ring.cosines[j];
+        }
+    }
+}
+
+void benchmarkRevolution() {
+    struct Case {
+        const char* name;
+        int profilePoints;
+        int steps;
+    };
+    const Case cases[] = {
+        { "8-point profile, steps=100", 8, 100 },
+        { "10k-point profile, steps=16", 10000, 16 },
+    };
+
+    for (const auto& c : cases) {
+        std::vector<glm::vec2> profile(c.profilePoints);
+        for (int k = 0; k < c.profilePoints; k++)
+            profile[k] = glm::vec2(0.5f + 0.25f * sinf(0.1f * k), -1.0f + 2.0f * k / (c.profilePoints - 1));
+
+        //best of a few runs, so the first touch of the memory does not count
+        const auto time = [&](const auto& generate) {
+            double best = 1e30;
+            for (int run = 0; run < 5; run++) {
+                std::vector<GLfloat> v;
+                v.reserve(3 * (profile.size() - 1) * (c.steps + 1) * c.steps);
+                const auto start = std::chrono::steady_clock::now();
+                generate(&v);
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count());
+            }
+            return best;
+        };
+
+        const auto scalarMs = time([&](std::vector<GLfloat>* v) {
+            for (size_t k = 1; k < profile.size(); k++) {
+                const auto& p1 = profile[k - 1];
+                const auto& p2 = profile[k];
+                const auto yMin = fminf(p1[1], p2[1]);
+                const GLfloat iStep = abs(p1[1] - p2[1]) / c.steps;
+                const GLfloat jStep = 1.0f / c.steps;
+                for (int i = 0; i <= c.steps; i++)
+                    for (int j = 0; j < c.steps; j++) {
+                        const auto p = S(yMin + i * iStep, j * jStep, p1, p2);
+                        v->insert(v->end(), { p.x, p.y, p.z });
+                    }
+            }
+        });
+        const auto kernelMs = time([&](std::vector<GLfloat>* v) {
+            const auto ring = createAngularRing(c.steps);
+            const auto segmentFloats = 3 * segmentVertexCount(Tessellation{ c.steps, c.steps });
+            v->resize((profile.size() - 1) * segmentFloats);
+            for (size_t k = 1; k < profile.size(); k++)
+                revolveSegment(v->data() + (k - 1) * segmentFloats, ring, c.steps, profile[k - 1], profile[k]);
+        });
+
+        std::cout << c.name << ": S() " << scalarMs << " ms, ring kernel " << kernelMs
+                  << " ms (" << scalarMs / kernelMs << "x)" << std::endl;
+    }
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include "ruledMesh.h"
+
+bool tessellateSegments(RuledGeometry& geometry, const std::vector<size_t>& dirty, const std::vector<glm::vec2>& editorVertices,
+    const std::function<bool()>& cancelled);
+void growRuledMesh(RuledMesh& mesh, const size_t capacity);
+
+//Evaluates every (u,v) lattice point once and connects them with indices.
+//v = 1 is the same circle point as v = 0, so each row wraps around to its first vertex.
+void createRuled(GLfloat* vertices, GLuint* indices, const GLuint first, const AngularRing& ring, const int row_count, const glm::vec2& p1, const glm::vec2& p2) {
+    const auto step_count = ring.steps;
+    revolveSegment(vertices, ring, row_count, p1, p2);
+
+    const auto vertex = [&](int i, int j) { return first + (GLuint)(i * step_count + j % step_count); };
+    for (int i = 0; i < row_count; i++)
+        for (int j = 0; j < step_count; j++) {
+            const std::array<GLuint, 6> quad{
+                vertex(i, j), vertex(i + 1, j), vertex(i + 1, j + 1), //lower triangle
+                vertex(i, j), vertex(i + 1, j + 1), vertex(i, j + 1), //upper triangle
+            };
+            indices = std::copy(quad.begin(), quad.end(), indices);
+        }
+}
+
+bool updateRuledGeometry(RuledGeometry& geometry, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices,
+    const std::function<bool()>& cancelled) {
+    const size_t segmentCount = editorVertices.size() > 1 ? editorVertices.size() - 1 : 0;
+    //every segment changes size with the tessellation
+    if (tessellation != geometry.tessellation) {
+        if (tessellation.steps != geometry.ring.steps) geometry.ring = createAngularRing(tessellation.steps);
+        geometry.tessellation = tessellation;
+        geometry.segments.clear();
+    }
+    if (geometry.mesh.use_count() > 1) geometry.mesh = std::make_shared<Mesh>(*geometry.mesh);
+    geometry.mesh->positions.resize(segmentCount * 3 * segmentVertexCount(tessellation));
+    geometry.mesh->indices.resize(segmentCount * segmentIndexCount(tessellation));
+
+    std::vector<size_t> dirty{};
+    geometry.segments.resize(segmentCount);
+    for (size_t k = 0; k < segmentCount; k++) {
+        const SegmentEnds ends{ editorVertices[k], editorVertices[k + 1] };
+        if (geometry.segments[k] != ends) dirty.push_back(k);
+        geometry.segments[k] = ends;
+    }
+    if (tessellateSegments(geometry, dirty, editorVertices, cancelled)) return true;
+
+    //NaN never compares equal, so these are rebuilt next time
+    const auto nan = std::numeric_limits<GLfloat>::quiet_NaN();
+    for (const auto k : dirty) geometry.segments[k][0] = glm::vec2(nan, nan);
+    return false;
+}
+
+size_t ruledGeometryWork(const RuledGeometry& geometry, const Tessellation& tessellation, const std::vector<glm::vec2>& editorVertices) {
+    size_t dirty = 0;
+    for (size_t k = 0; k + 1 < editorVertices.size(); k++)
+        if (tessellation != geometry.tessellation || k >= geometry.segments.size() ||
+            geometry.segments[k] != SegmentEnds{ editorVertices[k], editorVertices[k + 1] }) dirty++;
+    return dirty * (3 * segmentVertexCount(tessellation) + segmentIndexCount(tessellation));
+}
+
+//Every segment writes its own slice of the buffers, so the segments are
+//spread over threads without locking. Threads take small batches from a shared
+//counter, which keeps them busy even when the batches cost differently.
+bool tessellateSegments(RuledGeometry& geometry, const std::vector<size_t>& dirty, const std::vector<glm::vec2>& editorVertices,
+    const std::function<bool()>& cancelled) {
+    const auto vertexFloats = 3 * segmentVertexCount(geometry.tessellation);
+    const auto indexCount = segmentIndexCount(geometry.tessellation);
+    const auto tessellate = [&](size_t k) {
+        createRuled(&geometry.mesh->positions[k * vertexFloats], &geometry.mesh->indices[k * indexCount],
+            (GLuint)(k * segmentVertexCount(geometry.tessellation)), geometry.ring, geometry.tessellation.rows,
+            editorVertices[k], editorVertices[k + 1]);
+    };
+
+    //threads only pay off once there are about a million values to write
+    const size_t minWorkPerThread = 1 << 20;
+    const auto work = dirty.size() * (vertexFloats + indexCount);
+    const auto threadCount = (size_t)std::min<size_t>({ std::max(1u, std::thread::hardware_concurrency()), work / minWorkPerThread, dirty.size() });
+
+    const auto batch = std::max<size_t>(1, dirty.size() / (8 * std::max<size_t>(1, threadCount)));
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> stopped = false;
+    const auto worker = [&]() {
+        for (size_t first; (first = next.fetch_add(batch)) < dirty.size();) {
+            if (stopped || cancelled()) {
+                stopped = true;
+                return;
+            }
+            for (size_t i = first; i < std::min(first + batch, dirty.size()); i++) tessellate(dirty[i]);
+        }
+    };
+    {
+        std::vector<std::jthread> threads{};
+        for (size_t t = 1; t < threadCount; t++) threads.emplace_back(worker);
+        worker();
+    }
+    return !stopped;
+}
+
+void initRuledMesh(RuledMesh& mesh) {
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+}
+
+void uploadRuledMesh(RuledMesh& mesh, const RuledGeometry& geometry) {
+    const auto segmentCount = geometry.segments.size();
+    if (geometry.tessellation != mesh.tessellation) {
+        mesh.tessellation = geometry.tessellation;
+        mesh.segments.clear();
+        mesh.capacity = 0;
+    }
+    if (segmentCount > mesh.capacity)
+        growRuledMesh(mesh, std::max({ segmentCount, 2 * mesh.capacity, (size_t)4 }));
+
+    //one call per run of adjacent segments that changed
+    const auto vertexFloats = 3 * segmentVertexCount(mesh.tessellation);
+    const auto indexCount = segmentIndexCount(mesh.tessellation);
+    const auto changed = [&](size_t k) { return k >= mesh.segments.size() || mesh.segments[k] != geometry.segments[k]; };
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    for (size_t first = 0; first < segmentCount; first++) {
+        if (!changed(first)) continue;
+        auto end = first + 1;
+        while (end < segmentCount && changed(end)) end++;
+        glBufferSubData(GL_ARRAY_BUFFER, first * vertexFloats * sizeof(GLfloat), (end - first) * vertexFloats * sizeof(GLfloat), &geometry.mesh->positions[first * vertexFloats]);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * indexCount * sizeof(GLuint), (end - first) * indexCount * sizeof(GLuint), &geometry.mesh->indices[first * indexCount]);
+        first = end;
+    }
+    mesh.segments = geometry.segments;
+}
+
+//Moves the buffers to larger ones, copying the stored segments on the GPU.
+void growRuledMesh(RuledMesh& mesh, const size_t capacity) {
+    const auto vertexBytes = 3 * segmentVertexCount(mesh.tessellation) * sizeof(GLfloat);
+    const auto indexBytes = segmentIndexCount(mesh.tessellation) * sizeof(GLuint);
+    const auto keptSegments = std::min(mesh.segments.size(), mesh.capacity);
+
+    std::array<GLuint, 2> grown{};
+    glGenBuffers(2, grown.data());
+    const std::array<GLuint*, 2> buffers{ &mesh.VBO, &mesh.EBO };
+    const std::array<size_t, 2> segmentBytes{ vertexBytes, indexBytes };
+    for (size_t b = 0; b < buffers.size(); b++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown[b]);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * segmentBytes[b], nullptr, GL_DYNAMIC_DRAW);
+        if (keptSegments > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, *buffers[b]);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keptSegments * segmentBytes[b]);
+        }
+        glDeleteBuffers(1, buffers[b]);
+        *buffers[b] = grown[b];
+    }
+    mesh.capacity = capacity;
+
+    //the VAO still refers to the deleted buffers
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+}
+
+void deleteRuledMesh(RuledMesh& mesh) {
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+    glDeleteBuffers(1, &mesh.EBO);
+    mesh = RuledMesh{};
+}
+
+bool checkWatertight() {
+    const std::vector<glm::vec2> profile{ glm::vec2(0.0f, 0.5f), glm::vec2(0.4f, 0.1f), glm::vec2(0.3f, -0.3f), glm::vec2(0.0f, -0.6f) };
+    bool watertight = true;
+    for (const auto& tessellation : { Tessellation{ 100, 100 }, exactTessellation(0.001f) }) {
+        RuledGeometry geometry;
+        updateRuledGeometry(geometry, tessellation, profile);
+        const auto welded = weldMesh(*geometry.mesh);
+        const auto openEdges = openEdgeCount(welded);
+        std::cout << tessellation.rows << " rows, " << tessellation.steps << " steps: " << meshVertexCount(*geometry.mesh)
+                  << " vertices welded to " << meshVertexCount(welded) << ", " << openEdges << " open edges" << std::endl;
+        if (openEdges != 0) watertight = false;
+    }
+    return watertight;
+}
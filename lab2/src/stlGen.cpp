@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "exportFile.h"
+
+#include "stlGen.h"
+
+
+using namespace std;
+
+//Binary little-endian STL: an 80 byte header, the triangle count, then per
+//triangle the normal, the three corners and a zero attribute.
+//STL has no shared vertices, so the mesh is not welded; triangles with two
+//corners at the same position, such as those on the axis, are dropped.
+void SaveSTL(const Mesh& mesh, std::string filename, ExportProgress* progress) {
+	static_assert(std::endian::native == std::endian::little, "the STL is written in the native byte order");
+	const auto sourceCount = meshTriangleCount(mesh);
+	if (progress != nullptr) progress->total = sourceCount;
+	const auto corner = [&](GLuint index) { return glm::vec3(mesh.positions[3 * index], mesh.positions[3 * index + 1], mesh.positions[3 * index + 2]); };
+	const auto degenerate = [&](const GLuint* index) {
+		const auto a = corner(index[0]), b = corner(index[1]), c = corner(index[2]);
+		return a == b || b == c || c == a;
+	};
+	//the count comes before the triangles, so it takes a pass of its own
+	uint32_t triangleCount = 0;
+	for (size_t t = 0; t < sourceCount; t++) if (!degenerate(&mesh.indices[3 * t])) triangleCount++;
+
+	ExportFile myfile;
+	if (!openExportFile(myfile, filename, progress)) return;
+
+	char header[80] = "made by Bedrich Benes bbenes@purdue.edu";
+	writeExportFile(myfile, header, sizeof(header));
+	writeExportFile(myfile, (const char*)&triangleCount, sizeof(triangleCount));
+
+	const size_t triangleSize = 12 * sizeof(float) + sizeof(uint16_t);
+	const size_t blockTriangles = 1 << 16;
+	std::vector<char> block(blockTriangles * triangleSize, 0);
+	for (size_t first = 0; first < sourceCount; first += blockTriangles) {
+		if (progress != nullptr && progress->cancelled) break;
+		const auto count = std::min<size_t>(blockTriangles, sourceCount - first);
+		size_t written = 0;
+		for (size_t i = 0; i < count; i++) {
+			const auto index = &mesh.indices[3 * (first + i)];
+			if (degenerate(index)) continue;
+			//normal first, then the corners
+			std::array<glm::vec3, 4> facet{
+				glm::vec3(0.0f), corner(index[0]), corner(index[1]), corner(index[2])
+			};
+			const auto normal = glm::cross(facet[2] - facet[1], facet[3] - facet[1]);
+			if (glm::length(normal) > 0) facet[0] = glm::normalize(normal);
+			//the attribute byte count stays zero
+			std::memcpy(&block[written++ * triangleSize], facet.data(), 12 * sizeof(float));
+		}
+		writeExportFile(myfile, block.data(), written * triangleSize);
+		if (progress != nullptr) {
+			progress->done += count;
+			progress->bytes += written * triangleSize;
+		}
+	}
+	finishExportFile(myfile, filename, progress);
+
+}